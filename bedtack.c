@@ -17,9 +17,24 @@
 */
 #include<stdio.h>
 #include<stdlib.h>
+#include<stddef.h>
 #include<string.h>
+#include<limits.h>
+#include<float.h>
+#include<math.h>
 #include<unistd.h> // required for optopt, opterr and optarg.
+#include<getopt.h> // long options
+#include<time.h>
 #include <locale.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <pthread.h>
+#include <zlib.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #ifdef DBG
 #define GBUF 4
@@ -30,23 +45,77 @@
 #endif
 
 #define NUMBUCKETS 20
+// values are put in histogram buckets this many at a time
+#define HGBLK 1024
+// log2 histograms have a bucket per float exponent
+#define LGBUCKETS 256
+
+// most words we keep slices for on a line; the gff2 motif is the 10th. Extra words are counted but not kept.
+#define MXWPL 16
+// first arena block size, they double from there up to ARMX
+#define AR0 (1L<<16)
+#define ARMX (1L<<24)
+// mapped input gets handed back in steps of this size once the tokenizer is past it (must be a multiple of the page size)
+#define RLSZ (1L<<26)
+// gzip input is inflated into the tokenizer's buffer this much at a time
+#define GZCHNK (1L<<20)
+// BGZF blocks are inflated by the pool this many at a time (each is at most 64k inflated)
+#define BZBLKS 64
+// files smaller than this aren't worth parsing in chunks
+#define PCMIN (1L<<22)
+// how -m sums up the signal of a merged run
+#define AG_MIN 0
+#define AG_MAX 1
+#define AG_MEAN 2
+#define AG_SUM 3
+// --stats output
+#define ST_OFF 0
+#define ST_TSV 1
+#define ST_JSON 2
+// what memory is counted under, for --stats
+#define MA_ROWS 0
+#define MA_STR 1
+#define MA_IDX 2
+#define MA_JOIN 3
+#define MA_N 4
+// how much of a file --mem-limit looks at to size it up
+#define MLSMP (1L<<20)
+// default memory budget of the sort (-k), in MB
+#define SRTMB 512
+// rows are put together in an output buffer of this size before they're written
+#define OBSZ (1L<<20)
+// each -P output is buffered this much before it's written
+#define POBUF (1L<<16)
+// most threads inflating BGZF blocks when -t doesn't say
+#define MXBZT 8
+
+// .btk sidecars: magic (with the format version), their kinds, and most sections one can have
+#define BTKMG "BTK\0\0\0\0\1"
+#define BK_BGC 1
+#define BK_BED2 2
+#define BK_IDX 3
+// region index windows are 1<<IXSH bases, as in tabix
+#define IXSH 14
+#define BTKNS 8
 
 // the following is the way we cut out columns that have nothing in them.
 #define MXCOL2VIEW 4
 
+// grows by c at first, then doubles, so filling an array of N costs O(N) copying in all
 #define CONDREALLOC(x, b, c, a, t); \
 	if((x)>=((b)-1)) { \
-		(b) += (c); \
+		size_t ob_=(b); \
+		(b) = ((b)<(c))? (b)+(c) : 2*(b); \
 		(a)=realloc((a), (b)*sizeof(t)); \
-		memset(((a)+(b)-(c)), 0, (c)*sizeof(t)); \
+		memset(((a)+ob_), 0, ((b)-ob_)*sizeof(t)); \
 	}
 
 typedef unsigned char boole;
 
 typedef struct /* ia_t integer array type, includes iab the buffer */
 {
-	int *a;
-	unsigned b /* int array buf */, z /* int array size*/;
+	size_t *a;
+	size_t b /* int array buf */, z /* int array size*/;
 } ia_t;
 
 typedef struct /* opt_t, a struct for the options */
@@ -54,34 +123,77 @@ typedef struct /* opt_t, a struct for the options */
 	boole dflg; /* details / information only */
 	boole nflg; /* feature names only */
 	boole sflg; /* split outout in two files */
+	boole Sflg; /* stream the bedgraph instead of loading it */
+	boole lflg; /* log2 histogram buckets */
+	boole wflg; /* bedgraph rows partly in a feature count for the part that is in it */
+	boole cflg; /* keep the parsed -i and -f files in .btk sidecars, and load them from there next time */
+	int nbk; /* number of histogram buckets */
+	int nthr; /* number of threads the joins run on */
 	char *istr; /* first bedgraph file, the target of the filtering by the second */
 	char *fstr; /* the name of the second bedgraph file */
+	char **fx; /* any more -f files, only for coverage of the -g file */
+	int nfx;
 	char *ustr; /* the name of a file with the list of elements to be unified */
 	char *pstr; /* depth file name */
 	char *gstr; /* genome file name */
 	char *rstr; /* repeatmasker ggf2 file */
+	char *qstr; /* region to query, chr:start-end, or a bed file of them */
+	char *kstr; /* file to sort */
+	size_t srtz; /* memory the sort may use for its runs, in bytes (-M gives it in MB) */
+	boole mflg; /* merge the -i bedgraph's rows at or above minsig */
+	float minsig;
+	long gap; /* rows this far apart, or less, still merge */
+	int agg; /* what the merged rows' signal is: AG_MIN etc. */
+	char *Pstr; /* what -P partitions the -f file by: name, chrom or a column number */
+	int stfmt; /* --stats: ST_OFF, ST_TSV or ST_JSON */
+	size_t mlim; /* --mem-limit, in bytes, 0 for none */
+	boole smi, smp; /* the -i and -p files are to be streamed to stay under mlim */
 } opt_t;
 
-typedef struct /* i4_t */
+typedef struct /* po_t: one of the outputs of -P */
 {
-	int sc; /* number of same chromosome (occurences?) */
-	float mc; /* min signal value */
-	int b1i; /* index of the 1st bgr_t, which satisfies the conditions */
-	int lgbi; /* last good bgr_t index */
-} i4_t; /* 4 vals of some sort? */
-
-typedef struct /* bgr_t */
+	char *fn; /* its file name */
+	char *b; /* what's waiting to be written */
+	size_t z;
+	size_t nl; /* lines it got */
+	boole wtn; /* the file has been started */
+} po_t;
+
+typedef struct /* mr_t: a run of bedgraph rows being merged by -m */
 {
-	char *n;
-	size_t nsz; /* size of the name r ID field */
-	long c[2]; /* coords: 1) start 2) end */
-	float co; /* signal value */
-} bgr_t; /* bedgraph row type */
+	int g; /* chromosome id, -1 if there's no run open */
+	long s, e; /* start of the first row, furthest end so far */
+	float mn, mx; /* lowest and highest signal */
+	double sm; /* signal times bases, summed over the rows */
+	long nb; /* bases the rows cover, for the mean */
+} mr_t;
+
+typedef struct /* bgc_t: bedgraph in columns, i.e. one array per field, so scans only pull in the field they look at */
+{
+	int *ci; /* chromosome ids, the names are in the chromosome dictionary */
+	long *st; /* starts */
+	long *en; /* ends */
+	float *co; /* signal values */
+	size_t m; /* number of rows */
+	size_t b; /* size of the buffers */
+	char *mp; /* if it came from a .btk sidecar: the mapping st, en and co are in */
+	size_t mpsz;
+	boole mci; /* ci is in the mapping too */
+} bgc_t; /* bedgraph column type */
+
+typedef struct /* hg_t: histogram of signal values */
+{
+	size_t *b; /* bucket counts, with one more on the end for NaNs, which don't get shown */
+	int nb; /* number of buckets */
+	boole lg; /* log2 buckets: bucket e holds values with float exponent e, i.e. [2^(e-127), 2^(e-126)), bucket 0 anything not above 0 (and denormals) */
+	float *lim; /* linear buckets: upper limits of all but the last */
+	float mn, rstep; /* linear buckets: lowest value, and buckets per unit of signal */
+	size_t m; /* number of values */
+} hg_t;
 
 typedef struct /* bgr_t2 */
 {
-	char *n;
-	size_t nsz; /* size of the name r ID field */
+	int ci; /* chromosome id, the name is in the chromosome dictionary */
 	long c[2]; /* coords: 1) start 2) end */
 	char *f; /* f for feature .. 4th col */
 	size_t fsz; /* size of the feature field*/
@@ -89,8 +201,7 @@ typedef struct /* bgr_t2 */
 
 typedef struct /* rmf_t: repeatmasker gff2 file format */
 {
-	char *n;
-	size_t nsz; /* size of the name r ID field */
+	int ci; /* chromosome id, the name is in the chromosome dictionary */
 	long c[2]; /* coords: 1) start 2) cols 4 and 5 */
 	char *m; /* the motif string ... 9th column */
 	char sd; /* strand + or - */
@@ -103,64 +214,384 @@ typedef struct /* words_t: file with only single words per line */
 	size_t nsz; /* size of the name r ID field */
 } words_t; /* bedgraph row type */
 
-typedef struct /* dpf_t : depth file type ... just chr name, pos and read quant */
+typedef struct /* ws_t: a set of words, for looking feature names up in the -u list */
 {
-	char *n;
-	size_t nsz; /* size of the name r ID field */
-	long p; /* position */
+	words_t *w; /* the words, the set only holds their indices */
+	int *ht; /* open addressing on hashsl(), -1 for empty */
+	unsigned htz; /* slots, a power of 2 */
+} ws_t;
+
+typedef struct /* dpf_t : depth file type ... just chr name, pos and read quant. Lines of the same depth at positions one after the other are the one row */
+{
+	int ci; /* chromosome id, the name is in the chromosome dictionary */
 	int d; /* depth reading */
+	long p; /* first position */
+	long n; /* number of positions */
 } dpf_t;
 
 typedef struct /* gf_t : genome file type ... just chr name, pos and read quant */
 {
-	char *n;
-	size_t nsz; /* size of the name r ID field */
+	int ci; /* chromosome id, the name is in the chromosome dictionary */
 	long z; /* size of the the chromosome */
 } gf_t;
 
-typedef struct /* wseq_t */
+typedef struct /* cd_t: chromosome dictionary, each name is kept once and rows refer to it by its id */
+{
+	char **n; /* names, indexed by id */
+	size_t *nsz; /* their sizes, including the null */
+	int z, b; /* number of names and size of the buffer */
+	int *ht; /* hash table of ids, -1 for an empty slot */
+	unsigned htz; /* number of slots in ht, always a power of 2 */
+	int lk; /* id of the last lookup, rows tend to come in runs of the same chromosome */
+} cd_t;
+
+typedef struct /* bb_t: a batch of BGZF blocks, inflated one after the other into o */
+{
+	char *o;
+	size_t osz; /* total inflated size */
+	size_t zo[BZBLKS], zl[BZBLKS], oo[BZBLKS]; /* for each block: where its deflate data is, how long it is and where it inflates to */
+	unsigned ol[BZBLKS]; /* inflated size of each block, from its trailer */
+	int n, nxt, ndone; /* number of blocks, next one for a thread to take, number finished */
+	boole err; /* a block didn't inflate */
+} bb_t;
+
+typedef struct /* gz_t: gzip input. Plain gzip is one stream so it's inflated as the tokenizer goes. BGZF is made up of independent blocks, which a pool of threads inflates a batch ahead of the tokenizer */
+{
+	char *fn; /* the file's name, for errors */
+	char *z; /* the compressed file, mapped or read in */
+	size_t zsz, zo; /* its size, and how far into it has been handed out */
+	char *zrl; /* mapped pages before this have been handed back */
+	boole zmpd; /* 1 if z is an mmap */
+	boole bgzf;
+	boole eof; /* all of it has been inflated */
+	z_stream zs; /* plain gzip only */
+	bb_t bb[2]; /* BGZF: while the tokenizer reads from one, the other is being inflated */
+	int cur; /* the one the tokenizer gets next */
+	bb_t *pend; /* the batch the threads are on */
+	int nt; /* number of threads */
+	pthread_t *th;
+	pthread_mutex_t mx;
+	pthread_cond_t cv; /* threads wait on this for blocks, and the tokenizer for them to be done */
+	boole quit;
+} gz_t;
+
+typedef struct /* ob_t: an output stream's buffer, rows are formatted into it and written a block at a time */
+{
+	int fd;
+	char *b;
+	size_t z; /* bytes waiting to be written */
+} ob_t;
+
+typedef struct /* mf_t: an input file, memory-mapped and handed out line by line */
+{
+	char *d; /* the mapping (or the buffer, if the file could not be mapped, or gzip input is inflated into) */
+	size_t sz; /* size of the file in bytes (size of the buffer for gzip input) */
+	char *p; /* where the next line starts */
+	char *e; /* one past the last byte */
+	char *rl; /* mapped pages before this have been handed back */
+	boole mpd; /* 1 if d is an mmap, 0 if it was read into a malloc'd buffer */
+	gz_t *gz; /* NULL unless the file is gzipped */
+	size_t nl; /* lines handed out */
+} mf_t;
+
+typedef struct /* sl_t: a slice, i.e. a word pointing into the mapping. Not null-terminated! */
+{
+	char *s;
+	size_t l;
+} sl_t;
+
+typedef struct /* ar_t: arena, a file's strings go one after the other into big blocks, which are freed all at once */
+{
+	char **bk; /* the blocks */
+	int nb, bb; /* number of blocks and size of the bk buffer */
+	size_t bsz; /* size of the last block */
+	size_t u; /* bytes used in the last block */
+	size_t tz; /* bytes in all the blocks */
+	char *mp; /* a .btk sidecar whose strings are being used, unmapped along with the arena */
+	size_t mpsz;
+} ar_t;
+
+typedef struct /* bh_t: head of a .btk sidecar, which holds a parsed file in a form that can be mapped straight back in */
+{
+	char mg[8]; /* BTKMG */
+	int kd; /* kind, BK_BGC or BK_BED2 */
+	int n; /* number of columns the file had */
+	long srcsz, mts, mtns; /* size and modification time of the file it was parsed from: if they change it's out of date */
+	size_t m; /* number of rows */
+	size_t ng; /* number of chromosome names */
+	size_t o[BTKNS]; /* where each section starts: the names, then the rows' ids for them, then the kind's own columns */
+	size_t sz; /* size of the sidecar */
+} bh_t;
+
+typedef struct /* ix_t: region index of a sorted bedgraph or bed, giving for each window of IXSH bases the offset of the first line reaching into it */
+{
+	int *ci; /* chromosome id of each window */
+	long *o; /* offset of each window's first line */
+	size_t m; /* number of windows */
+	size_t b; /* size of the ci and o buffers, if they were built here rather than mapped */
+	size_t *gs; /* where each chromosome id's windows begin, their window numbers go up from 0. There are ng+1 of them */
+	int ng;
+	char *mp; /* the .bti sidecar, if it came from one */
+	size_t mpsz;
+	boole mci; /* ci is in the mapping */
+} ix_t;
+
+typedef struct pc_s /* pc_t: a chunk of a file, parsed by one thread into rows of its own */
+{
+	mf_t *mf; /* the chunk: a view into the file's mapping, or the whole file if there's only the one chunk */
+	cd_t *cd; /* the chunk's own chromosome names, the ids in its rows are for these */
+	ar_t *ar; /* its strings */
+	char *r; /* its rows */
+	size_t m, b; /* number of rows and size of the buffer */
+	size_t nl; /* number of lines, more than m if some were folded into the row before */
+	int k0; /* words on its first line */
+	size_t *xl; /* lines which don't have k0 words ... */
+	int *xn; /* ... and how many they do have */
+	size_t nx, bx;
+	boole bad; /* a line couldn't be taken (line m), so it stopped there */
+} pc_t;
+
+typedef struct /* pf_t: a file parsed in chunks, aligned to lines, a thread to each chunk */
+{
+	pc_t *pc; /* the chunks */
+	int nk; /* how many */
+	size_t rsz; /* size of a row */
+	boole (*f)(pc_t *pc, sl_t *w, int nw, char *r); /* parses a line into row r, 0 if it can't, 2 if it went into the row before r instead */
+	mf_t *mf; /* the whole file */
+} pf_t;
+
+typedef struct /* sk_t: sort key of a line */
+{
+	int r; /* rank of its chromosome */
+	long s, e; /* start and end */
+	size_t q; /* where it was in the run, so lines which are otherwise equal stay in file order */
+	size_t o; /* the line, in the run's text */
+	size_t l; /* its length */
+} sk_t;
+
+typedef struct /* sr_t: a sorted run spilled to disk, and the line at its head during the merge */
+{
+	mf_t *mf;
+	sk_t k; /* head line's key: o is left unused */
+	char *t; /* head line */
+	boole eof;
+} sr_t;
+
+typedef struct /* cn_t: a chromosome name, for putting them in order */
+{
+	int gi; /* its place in the genome file, INT_MAX if not in it */
+	char *n;
+	int id;
+} cn_t;
+
+typedef struct /* bgl_t: a bedgraph line, on its way to the columns of a bgc_t */
+{
+	int ci;
+	long st, en;
+	float co;
+} bgl_t;
+
+typedef struct /* fk_t: feature key, for putting features in start order chromosome by chromosome */
+{
+	int g; /* chromosome id */
+	long s; /* start */
+	long e; /* end */
+	long mx; /* highest end under this key in the interval tree */
+	size_t i; /* index of the feature */
+} fk_t;
+
+typedef struct /* fs_t: features set up for a sweep, i.e. put in start order chromosome by chromosome */
+{
+	fk_t *fk; /* feature keys, sorted */
+	size_t *gs; /* where each chromosome's features begin in fk, indexed by chromosome id. There are ng+1 of them */
+	int ng; /* number of chromosome ids when the features were set up */
+	size_t m; /* number of features */
+	size_t *act; /* indices of the features which are open */
+	size_t na; /* number of open features */
+	size_t nxt, lst; /* next feature key to open, and one past the current chromosome's last one */
+	int *lv; /* for lookups: the level of the root of each chromosome's interval tree, -1 if it has no features */
+	size_t *nc; /* features compared with on each chromosome, by its lookups (one thread a chromosome), and on all of them by the sweep, at ng */
+} fs_t;
+
+typedef struct /* jt_t: totals of a bedgraph to feature join, one of each per feature */
+{
+	long *reghits; /* hits for region: number of lines in bed1 which coincide with a region in bed2 */
+	long *cloci; /* as opposed to hit, catch the number of loci */
+	double *assoctval;
+	size_t m; /* number of features */
+} jt_t;
+
+typedef struct /* sg_t: a stage of the run, timed and counted for --stats */
+{
+	char *nm;
+	double w, c; /* wall and cpu seconds: when it began, then how long it took */
+	size_t rows, bytes, hits, cmps; /* the counts in st_t when it began, then how much they went up by */
+} sg_t;
+
+typedef struct /* st_t: what --stats reports. Stages can be inside others, an output inside its join say */
+{
+	int fmt; /* ST_OFF etc. */
+	sg_t *sg;
+	int z, b;
+	size_t rows; /* lines read, added up as each file is closed */
+	size_t bytes; /* input bytes, as they are on disk */
+	size_t hits; /* rows (or positions, or features) the joins matched to features */
+	size_t cmps; /* features the lookups and sweeps compared rows with */
+	size_t ma[MA_N]; /* bytes allocated and not freed yet for rows, strings, indexes and join tallies (MA_ROWS etc.) */
+	size_t mpk[MA_N]; /* the most each of those has been */
+	size_t mt, mtpk; /* all of them together, and the most that's been */
+} st_t;
+
+static st_t stats; /* global, with bznt below: every stage adds to it, and threading it through all of them would be a lot of noise */
+static int bznt; /* threads inflating BGZF input: -t's, or 0 for one a CPU (up to MXBZT). Every mfopen() would need it passed */
+
+void mamax(size_t *pk, size_t v) /* raise the high-water mark pk to v, if it's under */
+{
+	size_t o=__atomic_load_n(pk, __ATOMIC_RELAXED);
+	while( (v > o) && (!__atomic_compare_exchange_n(pk, &o, v, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) )
+		;
+}
+
+void macnt(int k, size_t z) /* z more bytes allocated for k (MA_ROWS etc.). The parsing and join threads do this too */
 {
-	size_t *wln;
-	size_t wsbuf;
-	size_t quan;
-	size_t lbuf; /* a buffer for the number of lines */
-	size_t numl; /* number of lines, i.e. rows */
-	size_t *wpla; /* words per line array: the number of words on each line */
-} wseq_t;
+	mamax(stats.mpk+k, __atomic_add_fetch(stats.ma+k, z, __ATOMIC_RELAXED));
+	mamax(&stats.mtpk, __atomic_add_fetch(&stats.mt, z, __ATOMIC_RELAXED));
+}
 
-wseq_t *create_wseq_t(size_t initsz)
+void mafree(int k, size_t z) /* z bytes counted by macnt() under k are freed */
 {
-	wseq_t *words=malloc(sizeof(wseq_t));
-	words->wsbuf = initsz;
-	words->quan = initsz;
-	words->wln=calloc(words->wsbuf, sizeof(size_t));
-	words->lbuf=WBUF;
-	words->numl=0;
-	words->wpla=calloc(words->lbuf, sizeof(size_t));
-	return words;
+	__atomic_sub_fetch(stats.ma+k, z, __ATOMIC_RELAXED);
+	__atomic_sub_fetch(&stats.mt, z, __ATOMIC_RELAXED);
 }
 
+typedef struct /* pj_t: a job split into parts, usually chromosomes, for a pool of threads. Each thread takes the next part until none are left */
+{
+	void (*f)(void *a, int g); /* does part g */
+	void *a; /* what f needs */
+	int np; /* number of parts */
+	int nxt; /* next part to be taken */
+	pthread_mutex_t mx;
+} pj_t;
+
 int catchopts(opt_t *opts, int oargc, char **oargv)
 {
 	int c;
 	opterr = 0;
 
-	while ((c = getopt (oargc, oargv, "dsni:f:u:p:g:r:")) != -1)
+	static struct option lo[]={ /* the long options, which have no short ones */
+		{"stats", optional_argument, NULL, 1},
+		{"mem-limit", required_argument, NULL, 2},
+		{NULL, 0, NULL, 0}
+	};
+
+	while ((c = getopt_long (oargc, oargv, "dsSnlcwb:t:i:f:u:p:g:r:q:k:M:m:G:a:P:", lo, NULL)) != -1)
 		switch (c) {
+			case 2: { /* --mem-limit N[KMG] */
+				char *e;
+				double v=strtod(optarg, &e);
+				int sh=(*e=='K' || *e=='k')? 10 : (*e=='M' || *e=='m')? 20 : (*e=='G' || *e=='g')? 30 : 0;
+				if( (v<=0) || ((sh) && (e[1])) || ((!sh) && (*e)) ) {
+					fprintf (stderr, "Error: --mem-limit needs a size, in bytes or with K, M or G on the end.\n");
+					exit(EXIT_FAILURE);
+				}
+				opts->mlim = (size_t)(v*(1L<<sh));
+				break;
+			}
+			case 1: /* --stats[=tsv|json] */
+				if( (!optarg) || (!strcmp(optarg, "tsv")) )
+					opts->stfmt = ST_TSV;
+				else if(!strcmp(optarg, "json"))
+					opts->stfmt = ST_JSON;
+				else {
+					fprintf (stderr, "Error: --stats can be tsv or json.\n");
+					exit(EXIT_FAILURE);
+				}
+				break;
 			case 'd':
 				opts->dflg = 1;
 				break;
 			case 's':
 				opts->sflg = 1;
 				break;
+			case 'S': /* stream, don't load */
+				opts->Sflg = 1;
+				break;
 			case 'n':
 				opts->nflg = 1;
 				break;
+			case 'q':
+				opts->qstr = optarg;
+				break;
+			case 'P': /* partition the feature file */
+				opts->Pstr = optarg;
+				break;
+			case 'k': /* sort a file */
+				opts->kstr = optarg;
+				break;
+			case 'M': /* sort's memory budget */
+				if(atol(optarg) < 1) {
+					fprintf (stderr, "Error: -M needs a number of megabytes, 1 or more.\n");
+					exit(EXIT_FAILURE);
+				}
+				opts->srtz = (size_t)atol(optarg)<<20;
+				break;
+			case 'm': /* merge rows with signal at or over this */
+				opts->mflg = 1;
+				opts->minsig = atof(optarg);
+				break;
+			case 'G': /* gap merging allows */
+				opts->gap = atol(optarg);
+				if(opts->gap < 0) {
+					fprintf (stderr, "Error: -G needs a number of bases, 0 or more.\n");
+					exit(EXIT_FAILURE);
+				}
+				break;
+			case 'a': /* signal of a merged run */
+				if(!strcmp(optarg, "min"))
+					opts->agg = AG_MIN;
+				else if(!strcmp(optarg, "max"))
+					opts->agg = AG_MAX;
+				else if(!strcmp(optarg, "mean"))
+					opts->agg = AG_MEAN;
+				else if(!strcmp(optarg, "sum"))
+					opts->agg = AG_SUM;
+				else {
+					fprintf (stderr, "Error: -a has to be min, max, mean or sum.\n");
+					exit(EXIT_FAILURE);
+				}
+				break;
+			case 't': /* threads for the joins */
+				opts->nthr = atoi(optarg);
+				if(opts->nthr < 1) {
+					fprintf (stderr, "Error: -t needs a number of threads, 1 or more.\n");
+					exit(EXIT_FAILURE);
+				}
+				break;
+			case 'w': /* partial overlaps count */
+				opts->wflg = 1;
+				break;
+			case 'c': /* .btk sidecar caches */
+				opts->cflg = 1;
+				break;
+			case 'l': /* log2 buckets for the histogram */
+				opts->lflg = 1;
+				break;
+			case 'b': /* number of buckets for the histogram */
+				opts->nbk = atoi(optarg);
+				if(opts->nbk < 2) {
+					fprintf (stderr, "Error: the histogram needs at least 2 buckets.\n");
+					exit(EXIT_FAILURE);
+				}
+				break;
 			case 'i':
 				opts->istr = optarg;
 				break;
 			case 'f':
-				opts->fstr = optarg;
+				if(opts->fstr) {
+					opts->fx=realloc(opts->fx, (opts->nfx+1)*sizeof(char*));
+					opts->fx[opts->nfx++] = optarg;
+				} else
+					opts->fstr = optarg;
 				break;
 			case 'u': /* unify certain bed2 elements into one file */
 				opts->ustr = optarg;
@@ -184,1061 +615,3248 @@ int catchopts(opt_t *opts, int oargc, char **oargv)
 	return 0;
 }
 
-void free_wseq(wseq_t *wa)
+double stnow(clockid_t ck) /* seconds on clock ck */
 {
-	free(wa->wln);
-	free(wa->wpla);
-	free(wa);
+	struct timespec ts;
+	clock_gettime(ck, &ts);
+	return ts.tv_sec + ts.tv_nsec/1e9;
 }
 
-words_t *processwordf(char *fname, int *m, int *n)
+int stbeg(char *nm) /* a stage called nm begins, the number it gets goes to stend() */
 {
-	/* In order to make no assumptions, the file is treated as lines containing the same amount of words each,
-	 * except for lines starting with #, which are ignored (i.e. comments). These words are checked to make sure they contain only floating number-type
-	 * characters [0123456789+-.] only, one string variable is continually written over and copied into a growing floating point array each time */
+	if(!stats.fmt)
+		return -1;
+	CONDREALLOC(stats.z, stats.b, GBUF, stats.sg, sg_t);
+	sg_t *g=stats.sg+stats.z;
+	g->nm=nm;
+	g->w=stnow(CLOCK_MONOTONIC);
+	g->c=stnow(CLOCK_PROCESS_CPUTIME_ID);
+	g->rows=stats.rows;
+	g->bytes=stats.bytes;
+	g->hits=stats.hits;
+	g->cmps=stats.cmps;
+	return stats.z++;
+}
 
-	/* declarations */
-	FILE *fp=fopen(fname,"r");
-	int i;
-	size_t couc /*count chars per line */, couw=0 /* count words */, oldcouw = 0;
-	int c;
-	boole inword=0;
-	wseq_t *wa=create_wseq_t(GBUF);
-	size_t bwbuf=WBUF;
-	char *bufword=calloc(bwbuf, sizeof(char)); /* this is the string we'll keep overwriting. */
-
-	words_t *bedword=malloc(GBUF*sizeof(words_t));
-
-	while( (c=fgetc(fp)) != EOF) { /* grab a char */
-		if( (c== '\n') | (c == ' ') | (c == '\t') | (c=='#')) { /* word closing events */
-			if( inword==1) { /* first word closing event */
-				wa->wln[couw]=couc;
-				bufword[couc++]='\0';
-				bufword = realloc(bufword, couc*sizeof(char)); /* normalize */
-				/* for the struct, we want to know if it's the first word in a line, like so: */
-				if(couw==oldcouw) {
-					bedword[wa->numl].n=malloc(couc*sizeof(char));
-					bedword[wa->numl].nsz=couc;
-					strcpy(bedword[wa->numl].n, bufword);
-				}
-				couc=0;
-				couw++;
-			}
-			if(c=='#') { /* comment case */
-				while( (c=fgetc(fp)) != '\n') ;
-				continue;
-			} else if(c=='\n') { /* end of a line */
-				if(wa->numl == wa->lbuf-1) { /* enought space in our current array? */
-					wa->lbuf += WBUF;
-					wa->wpla=realloc(wa->wpla, wa->lbuf*sizeof(size_t));
-					bedword=realloc(bedword, wa->lbuf*sizeof(words_t));
-					memset(wa->wpla+(wa->lbuf-WBUF), 0, WBUF*sizeof(size_t));
-				}
-				wa->wpla[wa->numl] = couw-oldcouw; /* number of words in current line */
-				if(couw-oldcouw >4) {
-					printf("Error, each row cannot exceed 4 words: revise your input file\n"); 
-					/* need to release all memory too */
-					free_wseq(wa);
-					exit(EXIT_FAILURE);
-				}
-				oldcouw=couw; /* restart words per line count */
-				wa->numl++; /* brand new line coming up */
-			}
-			inword=0;
-		} else if(inword==0) { /* deal with first character of new word, + and - also allowed */
-			if(couw == wa->wsbuf-1) {
-				wa->wsbuf += GBUF;
-				wa->wln=realloc(wa->wln, wa->wsbuf*sizeof(size_t));
-				bedword=realloc(bedword, wa->wsbuf*sizeof(words_t));
-				for(i=wa->wsbuf-GBUF;i<wa->wsbuf;++i)
-					wa->wln[i]=0;
-			}
-			couc=0;
-			bwbuf=WBUF;
-			bufword=realloc(bufword, bwbuf*sizeof(char)); /* don't bother with memset, it's not necessary */
-			bufword[couc++]=c; /* no need to check here, it's the first character */
-			inword=1;
-		} else {
-			if(couc == bwbuf-1) { /* the -1 so that we can always add and extra (say 0) when we want */
-				bwbuf += WBUF;
-				bufword = realloc(bufword, bwbuf*sizeof(char));
-			}
-			bufword[couc++]=c;
-		}
+void stend(int k) /* stage k is over */
+{
+	if(k<0)
+		return;
+	sg_t *g=stats.sg+k;
+	g->w=stnow(CLOCK_MONOTONIC) - g->w;
+	g->c=stnow(CLOCK_PROCESS_CPUTIME_ID) - g->c;
+	g->rows=stats.rows - g->rows;
+	g->bytes=stats.bytes - g->bytes;
+	g->hits=stats.hits - g->hits;
+	g->cmps=stats.cmps - g->cmps;
+	return;
+}
 
-	} /* end of big for statement */
-	fclose(fp);
-	free(bufword);
+void prtst(void) /* the stages, on stderr, as a tsv table or a json array, then the memory. Stages inside others are counted in theirs as well */
+{
+	int k;
+	sg_t *g;
+	if(stats.fmt==ST_TSV)
+		fprintf(stderr, "stage\twall_s\tcpu_s\trows\tbytes\thits\tcmps\n");
+	else
+		fprintf(stderr, "{\"stages\": [\n");
+	for(k=0;k<stats.z;++k) {
+		g=stats.sg+k;
+		if(stats.fmt==ST_TSV)
+			fprintf(stderr, "%s\t%.6f\t%.6f\t%zu\t%zu\t%zu\t%zu\n", g->nm, g->w, g->c, g->rows, g->bytes, g->hits, g->cmps);
+		else
+			fprintf(stderr, "  {\"stage\": \"%s\", \"wall_s\": %.6f, \"cpu_s\": %.6f, \"rows\": %zu, \"bytes\": %zu, \"hits\": %zu, \"cmps\": %zu}%s\n",
+				g->nm, g->w, g->c, g->rows, g->bytes, g->hits, g->cmps, (k<stats.z-1)? "," : "");
+	}
+	struct rusage ru;
+	char *mn[MA_N]={"rows", "strings", "indexes", "joins"};
+	getrusage(RUSAGE_SELF, &ru);
+	if(stats.fmt==ST_TSV)
+		fprintf(stderr, "memory\tpeak_bytes\n");
+	else
+		fprintf(stderr, "], \"memory\": {");
+	for(k=0;k<MA_N;++k)
+		fprintf(stderr, (stats.fmt==ST_TSV)? "%s\t%zu\n" : "\"%s\": %zu, ", mn[k], stats.mpk[k]);
+	fprintf(stderr, (stats.fmt==ST_TSV)? "all\t%zu\n" : "\"all\": %zu, ", stats.mtpk); /* at once, so no more than the kinds' peaks added up */
+	fprintf(stderr, (stats.fmt==ST_TSV)? "peak_rss\t%zu\n" : "\"peak_rss\": %zu}}\n", (size_t)ru.ru_maxrss<<10);
+	free(stats.sg);
+	return;
+}
 
-	/* normalization stage */
-	wa->quan=couw;
-	wa->wln = realloc(wa->wln, wa->quan*sizeof(size_t)); /* normalize */
-	bedword = realloc(bedword, wa->quan*sizeof(words_t)); /* normalize */
-	wa->wpla= realloc(wa->wpla, wa->numl*sizeof(size_t));
-
-	*m= wa->numl;
-	int k=wa->wpla[0];
-	for(i=1;i<wa->numl;++i)
-		if(k != wa->wpla[i])
-			printf("Warning: Numcols is not uniform at %i words per line on all lines. This file has one with %zu.\n", k, wa->wpla[i]); 
-	*n= k; 
-	free_wseq(wa);
+int bzhdr(unsigned char *z, size_t zsz, size_t *bl, size_t *hl) /* is there a BGZF block header at z: 1 if so, with its length in bl and its header's in hl */
+{
+	/* a gzip member with an extra field holding a BC subfield, which gives the block's size less one */
+	size_t i, xl;
+	if( (zsz<18) || (z[0]!=0x1f) || (z[1]!=0x8b) || (z[2]!=8) || !(z[3]&4) )
+		return 0;
+	xl=z[10]|(z[11]<<8);
+	for(i=12;i+4<=12+xl && i+4<=zsz;i+=4+(z[i+2]|(z[i+3]<<8)))
+		if( (z[i]=='B') && (z[i+1]=='C') && ((z[i+2]|(z[i+3]<<8))==2) ) {
+			*bl=(z[i+4]|(z[i+5]<<8))+1;
+			*hl=12+xl;
+			return (*bl >= *hl+8);
+		}
+	return 0;
+}
 
-	return bedword;
+void *bzthrd(void *a) /* a BGZF inflating thread: takes blocks off the pending batch until told to quit */
+{
+	gz_t *gz=a;
+	bb_t *bb;
+	int i, r;
+	z_stream zs={0};
+	inflateInit2(&zs, -15); /* raw deflate, the gzip wrapping of each block has already been stepped over */
+	for(;;) {
+		pthread_mutex_lock(&gz->mx);
+		while( (!gz->quit) && ((!gz->pend) || (gz->pend->nxt >= gz->pend->n)) )
+			pthread_cond_wait(&gz->cv, &gz->mx);
+		if(gz->quit) {
+			pthread_mutex_unlock(&gz->mx);
+			break;
+		}
+		bb=gz->pend;
+		i=bb->nxt++;
+		pthread_mutex_unlock(&gz->mx);
+
+		inflateReset(&zs);
+		zs.next_in=(unsigned char*)gz->z+bb->zo[i];
+		zs.avail_in=bb->zl[i];
+		zs.next_out=(unsigned char*)bb->o+bb->oo[i];
+		zs.avail_out=bb->ol[i];
+		r=inflate(&zs, Z_FINISH);
+
+		pthread_mutex_lock(&gz->mx);
+		if( (r!=Z_STREAM_END) || (zs.total_out!=bb->ol[i]) )
+			bb->err=1;
+		if(++bb->ndone == bb->n)
+			pthread_cond_broadcast(&gz->cv);
+		pthread_mutex_unlock(&gz->mx);
+	}
+	inflateEnd(&zs);
+	return NULL;
 }
 
-bgr_t *processinpf(char *fname, int *m, int *n)
+void bzsubmit(gz_t *gz, bb_t *bb) /* lay out the next batch of blocks in bb and hand it to the threads */
 {
-	/* In order to make no assumptions, the file is treated as lines containing the same amount of words each,
-	 * except for lines starting with #, which are ignored (i.e. comments). These words are checked to make sure they contain only floating number-type
-	 * characters [0123456789+-.] only, one string variable is continually written over and copied into a growing floating point array each time */
+	size_t bl, hl;
+	unsigned char *z;
+	if( (gz->zmpd) && (gz->z + gz->zo - gz->zrl > RLSZ) ) { /* all batches before this one are done with */
+		madvise(gz->zrl, RLSZ, MADV_DONTNEED);
+		gz->zrl += RLSZ;
+	}
+	bb->n=bb->nxt=bb->ndone=0;
+	bb->osz=0;
+	while( (bb->n<BZBLKS) && (gz->zo<gz->zsz) ) {
+		z=(unsigned char*)gz->z+gz->zo;
+		if( (!bzhdr(z, gz->zsz-gz->zo, &bl, &hl)) || (gz->zo+bl > gz->zsz) ) {
+			fprintf(stderr, "Error: file \"%s\" is not valid BGZF at offset %zu.\n", gz->fn, gz->zo);
+			exit(EXIT_FAILURE);
+		}
+		bb->zo[bb->n]=gz->zo+hl;
+		bb->zl[bb->n]=bl-hl-8;
+		bb->ol[bb->n]=z[bl-4]|(z[bl-3]<<8)|(z[bl-2]<<16)|((unsigned)z[bl-1]<<24);
+		bb->oo[bb->n]=bb->osz;
+		bb->osz += bb->ol[bb->n];
+		bb->n++;
+		gz->zo += bl;
+	}
+	pthread_mutex_lock(&gz->mx);
+	gz->pend=bb;
+	pthread_cond_broadcast(&gz->cv);
+	pthread_mutex_unlock(&gz->mx);
+}
 
-	/* declarations */
-	FILE *fp=fopen(fname,"r");
+gz_t *create_gz(char *z, size_t zsz, boole zmpd, char *fname)
+{
 	int i;
-	size_t couc /*count chars per line */, couw=0 /* count words */, oldcouw = 0;
-	int c;
-	boole inword=0;
-	wseq_t *wa=create_wseq_t(GBUF);
-	size_t bwbuf=WBUF;
-	char *bufword=calloc(bwbuf, sizeof(char)); /* this is the string we'll keep overwriting. */
-
-	bgr_t *bgrow=malloc(GBUF*sizeof(bgr_t));
-
-	while( (c=fgetc(fp)) != EOF) { /* grab a char */
-		if( (c== '\n') | (c == ' ') | (c == '\t') | (c=='#')) { /* word closing events */
-			if( inword==1) { /* first word closing event */
-				wa->wln[couw]=couc;
-				bufword[couc++]='\0';
-				bufword = realloc(bufword, couc*sizeof(char)); /* normalize */
-				/* for the struct, we want to know if it's the first word in a line, like so: */
-				if(couw==oldcouw) {
-					bgrow[wa->numl].n=malloc(couc*sizeof(char));
-					bgrow[wa->numl].nsz=couc;
-					strcpy(bgrow[wa->numl].n, bufword);
-				} else if((couw-oldcouw)<3) /* it's not the first word, and it's 1st and second col */
-					bgrow[wa->numl].c[couw-oldcouw-1]=atol(bufword);
-				else if( (couw-oldcouw)==3) { // assume float
-					bgrow[wa->numl].co=atof(bufword);
-				}
-				couc=0;
-				couw++;
-			}
-			if(c=='#') { /* comment case */
-				while( (c=fgetc(fp)) != '\n') ;
-				continue;
-			} else if(c=='\n') { /* end of a line */
-				if(wa->numl == wa->lbuf-1) { /* enought space in our current array? */
-					wa->lbuf += WBUF;
-					wa->wpla=realloc(wa->wpla, wa->lbuf*sizeof(size_t));
-					bgrow=realloc(bgrow, wa->lbuf*sizeof(bgr_t));
-					memset(wa->wpla+(wa->lbuf-WBUF), 0, WBUF*sizeof(size_t));
-				}
-				wa->wpla[wa->numl] = couw-oldcouw; /* number of words in current line */
-				if(couw-oldcouw >4) {
-					printf("Error, each row cannot exceed 4 words: revise your input file\n"); 
-					/* need to release all memory too */
-					free_wseq(wa);
-					exit(EXIT_FAILURE);
-				}
-				oldcouw=couw; /* restart words per line count */
-				wa->numl++; /* brand new line coming up */
-			}
-			inword=0;
-		} else if(inword==0) { /* deal with first character of new word, + and - also allowed */
-			if(couw == wa->wsbuf-1) {
-				wa->wsbuf += GBUF;
-				wa->wln=realloc(wa->wln, wa->wsbuf*sizeof(size_t));
-				bgrow=realloc(bgrow, wa->wsbuf*sizeof(bgr_t));
-				for(i=wa->wsbuf-GBUF;i<wa->wsbuf;++i)
-					wa->wln[i]=0;
-			}
-			couc=0;
-			bwbuf=WBUF;
-			bufword=realloc(bufword, bwbuf*sizeof(char)); /* don't bother with memset, it's not necessary */
-			bufword[couc++]=c; /* no need to check here, it's the first character */
-			inword=1;
-		} else {
-			if(couc == bwbuf-1) { /* the -1 so that we can always add and extra (say 0) when we want */
-				bwbuf += WBUF;
-				bufword = realloc(bufword, bwbuf*sizeof(char));
-			}
-			bufword[couc++]=c;
+	size_t bl, hl;
+	gz_t *gz=calloc(1, sizeof(gz_t));
+	gz->fn=fname;
+	gz->z=gz->zrl=z;
+	gz->zsz=zsz;
+	gz->zmpd=zmpd;
+	gz->bgzf=bzhdr((unsigned char*)z, zsz, &bl, &hl);
+	if(!gz->bgzf) {
+		if(inflateInit2(&gz->zs, 15+16) != Z_OK) {
+			fprintf(stderr, "Error: cannot set up to inflate \"%s\".\n", fname);
+			exit(EXIT_FAILURE);
 		}
+		gz->zs.next_in=(unsigned char*)z;
+		gz->zs.avail_in=zsz;
+		return gz;
+	}
+	gz->nt=bznt;
+	if(!gz->nt) {
+		gz->nt=sysconf(_SC_NPROCESSORS_ONLN);
+		if(gz->nt<1)
+			gz->nt=1;
+		if(gz->nt>MXBZT)
+			gz->nt=MXBZT;
+	}
+	for(i=0;i<2;++i)
+		gz->bb[i].o=malloc(BZBLKS*(1L<<16));
+	pthread_mutex_init(&gz->mx, NULL);
+	pthread_cond_init(&gz->cv, NULL);
+	gz->th=malloc(gz->nt*sizeof(pthread_t));
+	for(i=0;i<gz->nt;++i)
+		pthread_create(gz->th+i, NULL, bzthrd, gz);
+	bzsubmit(gz, gz->bb);
+	return gz;
+}
 
-	} /* end of big for statement */
-	fclose(fp);
-	free(bufword);
-
-	/* normalization stage */
-	wa->quan=couw;
-	wa->wln = realloc(wa->wln, wa->quan*sizeof(size_t)); /* normalize */
-	bgrow = realloc(bgrow, wa->quan*sizeof(bgr_t)); /* normalize */
-	wa->wpla= realloc(wa->wpla, wa->numl*sizeof(size_t));
-
-	*m= wa->numl;
-	int k=wa->wpla[0];
-	for(i=1;i<wa->numl;++i)
-		if(k != wa->wpla[i])
-			printf("Warning: Numcols is not uniform at %i words per line on all lines. This file has one with %zu.\n", k, wa->wpla[i]); 
-	*n= k; 
-	free_wseq(wa);
-
-	return bgrow;
+void free_gz(gz_t *gz)
+{
+	int i;
+	if(gz->bgzf) {
+		pthread_mutex_lock(&gz->mx);
+		gz->quit=1;
+		pthread_cond_broadcast(&gz->cv);
+		pthread_mutex_unlock(&gz->mx);
+		for(i=0;i<gz->nt;++i)
+			pthread_join(gz->th[i], NULL);
+		pthread_mutex_destroy(&gz->mx);
+		pthread_cond_destroy(&gz->cv);
+		free(gz->th);
+		for(i=0;i<2;++i)
+			free(gz->bb[i].o);
+	} else
+		inflateEnd(&gz->zs);
+	if(gz->zmpd)
+		munmap(gz->z, gz->zsz);
+	else
+		free(gz->z);
+	free(gz);
 }
 
-bgr_t2 *processinpf2(char *fname, int *m, int *n) /*fourth column is string, other columns to be ignored */
+int mfrefill(mf_t *mf) /* gzip input: move what's left of the buffer to its start and inflate more on after it. Returns 0 when there's no more */
 {
-	/* In order to make no assumptions, the file is treated as lines containing the same amount of words each,
-	 * except for lines starting with #, which are ignored (i.e. comments). These words are checked to make sure they contain only floating number-type
-	 * characters [0123456789+-.] only, one string variable is continually written over and copied into a growing floating point array each time */
+	gz_t *gz=mf->gz;
+	bb_t *bb;
+	size_t lo, want;
+	int r;
+	if( (!gz) || (gz->eof) )
+		return 0;
+	lo=mf->e - mf->p;
+	memmove(mf->d, mf->p, lo);
+	mf->p=mf->d;
+	mf->e=mf->d+lo;
+	if(gz->bgzf) {
+		bb=gz->bb+gz->cur;
+		pthread_mutex_lock(&gz->mx);
+		while(bb->ndone < bb->n)
+			pthread_cond_wait(&gz->cv, &gz->mx);
+		pthread_mutex_unlock(&gz->mx);
+		if(bb->err) {
+			fprintf(stderr, "Error: a BGZF block in \"%s\" failed to inflate.\n", gz->fn);
+			exit(EXIT_FAILURE);
+		}
+		if(!bb->n) {
+			gz->eof=1;
+			return 0;
+		}
+		gz->cur ^= 1;
+		bzsubmit(gz, gz->bb+gz->cur); /* the threads get on with the next batch while this one's copied out */
+		if(lo+bb->osz > mf->sz) {
+			mf->sz=2*(lo+bb->osz);
+			mf->d=realloc(mf->d, mf->sz);
+			mf->p=mf->d;
+		}
+		memcpy(mf->d+lo, bb->o, bb->osz);
+		mf->e=mf->d+lo+bb->osz;
+		return 1;
+	}
+	for(;;) { /* plain gzip, which may be several members one after the other */
+		if(lo+GZCHNK > mf->sz) {
+			mf->sz=2*(lo+GZCHNK);
+			mf->d=realloc(mf->d, mf->sz);
+			mf->p=mf->d;
+			mf->e=mf->d+lo;
+		}
+		want=mf->sz-lo;
+		gz->zs.next_out=(unsigned char*)mf->e;
+		gz->zs.avail_out=want;
+		r=inflate(&gz->zs, Z_NO_FLUSH);
+		mf->e += want - gz->zs.avail_out;
+		if(r==Z_STREAM_END) {
+			if( (gz->zs.avail_in>=2) && (gz->zs.next_in[0]==0x1f) && (gz->zs.next_in[1]==0x8b) )
+				inflateReset(&gz->zs);
+			else
+				gz->eof=1;
+		} else if( (r!=Z_OK) && !((r==Z_BUF_ERROR) && (gz->zs.avail_in)) ) {
+			fprintf(stderr, "Error: gzip file \"%s\" is corrupt or cut short.\n", gz->fn);
+			exit(EXIT_FAILURE);
+		}
+		if(mf->e > mf->d+lo)
+			return 1;
+		if(gz->eof)
+			return 0;
+	}
+}
 
-	/* declarations */
-	FILE *fp=fopen(fname,"r");
-	int i;
-	size_t couc /*count chars per line */, couw=0 /* count words */, oldcouw = 0;
-	int c;
-	boole inword=0;
-	wseq_t *wa=create_wseq_t(GBUF);
-	size_t bwbuf=WBUF;
-	char *bufword=calloc(bwbuf, sizeof(char)); /* this is the string we'll keep overwriting. */
-
-	bgr_t2 *bgrow=malloc(GBUF*sizeof(bgr_t2));
-
-	while( (c=fgetc(fp)) != EOF) { /* grab a char */
-		if( (c== '\n') | (c == ' ') | (c == '\t') | (c=='#')) { /* word closing events */
-			if( inword==1) { /* first word closing event */
-				wa->wln[couw]=couc;
-				bufword[couc++]='\0';
-				bufword = realloc(bufword, couc*sizeof(char)); /* normalize */
-				/* for the struct, we want to know if it's the first word in a line, like so: */
-				if(couw==oldcouw) {
-					bgrow[wa->numl].n=malloc(couc*sizeof(char));
-					bgrow[wa->numl].nsz=couc;
-					strcpy(bgrow[wa->numl].n, bufword);
-				} else if((couw-oldcouw)<3) { /* it's not the first word, and it's 1st and second col */
-					bgrow[wa->numl].c[couw-oldcouw-1]=atol(bufword);
-				} else if( (couw-oldcouw)==3) { // assume float
-					bgrow[wa->numl].f=malloc(couc*sizeof(char));
-					bgrow[wa->numl].fsz=couc;
-					strcpy(bgrow[wa->numl].f, bufword);
-				}
-				couc=0;
-				couw++;
-			}
-			if(c=='#') { /* comment case */
-				while( (c=fgetc(fp)) != '\n') ;
-				continue;
-			} else if(c=='\n') { /* end of a line */
-				if(wa->numl == wa->lbuf-1) { /* enought space in our current array? */
-					wa->lbuf += WBUF;
-					wa->wpla=realloc(wa->wpla, wa->lbuf*sizeof(size_t));
-					bgrow=realloc(bgrow, wa->lbuf*sizeof(bgr_t2));
-					memset(wa->wpla+(wa->lbuf-WBUF), 0, WBUF*sizeof(size_t));
-				}
-				wa->wpla[wa->numl] = couw-oldcouw; /* number of words in current line */
-				oldcouw=couw; /* restart words per line count */
-				wa->numl++; /* brand new line coming up */
-			}
-			inword=0;
-		} else if(inword==0) { /* deal with first character of new word, + and - also allowed */
-			if(couw == wa->wsbuf-1) {
-				wa->wsbuf += GBUF;
-				wa->wln=realloc(wa->wln, wa->wsbuf*sizeof(size_t));
-				bgrow=realloc(bgrow, wa->wsbuf*sizeof(bgr_t2));
-				for(i=wa->wsbuf-GBUF;i<wa->wsbuf;++i)
-					wa->wln[i]=0;
-			}
-			couc=0;
-			bwbuf=WBUF;
-			bufword=realloc(bufword, bwbuf*sizeof(char)); /* don't bother with memset, it's not necessary */
-			bufword[couc++]=c; /* no need to check here, it's the first character */
-			inword=1;
-		} else {
-			if(couc == bwbuf-1) { /* the -1 so that we can always add and extra (say 0) when we want */
-				bwbuf += WBUF;
-				bufword = realloc(bufword, bwbuf*sizeof(char));
+mf_t *mfopen(char *fname)
+{
+	/* map the whole file in, so lines can be sliced up without copying. Pipes and the like can't be
+	 * mapped, so they are read into a buffer instead, which is then used in exactly the same way. */
+	int fd=open(fname, O_RDONLY);
+	if(fd==-1) {
+		fprintf(stderr, "Error: cannot open file \"%s\".\n", fname);
+		exit(EXIT_FAILURE);
+	}
+	struct stat sb;
+	mf_t *mf=calloc(1, sizeof(mf_t));
+	if( (!fstat(fd, &sb)) && S_ISREG(sb.st_mode) && (sb.st_size>0) ) {
+		mf->d=mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if(mf->d!=MAP_FAILED) {
+			mf->sz=sb.st_size;
+			mf->mpd=1;
+			madvise(mf->d, mf->sz, MADV_SEQUENTIAL);
+		}
+	}
+	if(!mf->mpd) {
+		size_t rbuf=1<<16;
+		ssize_t r;
+		mf->d=malloc(rbuf);
+		mf->sz=0;
+		while( (r=read(fd, mf->d+mf->sz, rbuf-mf->sz)) > 0) {
+			mf->sz += r;
+			if(mf->sz==rbuf) {
+				rbuf *= 2;
+				mf->d=realloc(mf->d, rbuf);
 			}
-			bufword[couc++]=c;
 		}
-
-	} /* end of big for statement */
-	fclose(fp);
-	free(bufword);
-
-	/* normalization stage */
-	wa->quan=couw;
-	wa->wln = realloc(wa->wln, wa->quan*sizeof(size_t)); /* normalize */
-	bgrow = realloc(bgrow, wa->quan*sizeof(bgr_t2)); /* normalize */
-	wa->wpla= realloc(wa->wpla, wa->numl*sizeof(size_t));
-
-	*m= wa->numl;
-	int k=wa->wpla[0];
-	for(i=1;i<wa->numl;++i)
-		if(k != wa->wpla[i])
-			printf("Warning: Numcols is not uniform at %i words per line on all lines. This file has one with %zu.\n", k, wa->wpla[i]); 
-	*n= k; 
-	free_wseq(wa);
-
-	return bgrow;
+	}
+	close(fd);
+	stats.bytes += mf->sz;
+	if( (mf->sz>=2) && ((unsigned char)mf->d[0]==0x1f) && ((unsigned char)mf->d[1]==0x8b) ) { /* gzip or BGZF, known by its magic rather than its name */
+		mf->gz=create_gz(mf->d, mf->sz, mf->mpd, fname);
+		mf->mpd=0;
+		mf->sz=GZCHNK;
+		mf->d=malloc(mf->sz);
+		mf->p=mf->e=mf->rl=mf->d;
+		return mf;
+	}
+	mf->p=mf->rl=mf->d;
+	mf->e=mf->d+mf->sz;
+	return mf;
 }
 
-rmf_t *processrmf(char *fname, int *m, int *n) /*fourth column is string, other columns to be ignored */
+void mfclose(mf_t *mf)
 {
-	/* In order to make no assumptions, the file is treated as lines containing the same amount of words each,
-	 * except for lines starting with #, which are ignored (i.e. comments). These words are checked to make sure they contain only floating number-type
-	 * characters [0123456789+-.] only, one string variable is continually written over and copied into a growing floating point array each time */
+	stats.rows += mf->nl;
+	if(mf->gz)
+		free_gz(mf->gz);
+	if(mf->mpd)
+		munmap(mf->d, mf->sz);
+	else
+		free(mf->d);
+	free(mf);
+}
 
-	/* declarations */
-	FILE *fp=fopen(fname,"r");
-	int i;
-	size_t couc /*count chars per line */, couw=0 /* count words */, oldcouw = 0;
-	int c;
-	boole inword=0;
-	wseq_t *wa=create_wseq_t(GBUF);
-	size_t bwbuf=WBUF;
-	char *bufword=calloc(bwbuf, sizeof(char)); /* this is the string we'll keep overwriting. */
-
-	rmf_t *rmf=malloc(GBUF*sizeof(rmf_t));
-
-	while( (c=fgetc(fp)) != EOF) { /* grab a char */
-		if( (c== '\n') | (c == ' ') | (c == '\t') | (c=='#')) { /* word closing events */
-			if( inword==1) { /* first word closing event */
-				wa->wln[couw]=couc;
-				bufword[couc++]='\0';
-				bufword = realloc(bufword, couc*sizeof(char)); /* normalize */
-				/* for the struct, we want to know if it's the first word in a line, like so: */
-				if(couw==oldcouw) {
-					rmf[wa->numl].n=malloc(couc*sizeof(char));
-					rmf[wa->numl].nsz=couc;
-					strcpy(rmf[wa->numl].n, bufword);
-				} else if((couw-oldcouw)==3) { /* fourth col */
-					rmf[wa->numl].c[couw-oldcouw-3]=atol(bufword)-1L; // change to zero indexing
-				} else if((couw-oldcouw)==4) { /* it's not the first word, and it's 1st and second col */
-					rmf[wa->numl].c[couw-oldcouw-3]=atol(bufword); // no 0 indexing change required here.
-				} else if((couw-oldcouw)==6 )  { /* the strand */
-					rmf[wa->numl].sd=bufword[0];
-				} else if( (couw-oldcouw)==9) { // the motif string
-					rmf[wa->numl].m=malloc(couc*sizeof(char));
-					rmf[wa->numl].msz=couc;
-					strcpy(rmf[wa->numl].m, bufword);
-				}
-				couc=0;
-				couw++;
-			}
-			if(c=='#') { /* comment case */
-				while( (c=fgetc(fp)) != '\n') ;
+int mfnxtl(mf_t *mf, sl_t *w, int mxw) /* slice up the next line into words: returns the number of words or -1 at end of file */
+{
+	/* newlines are found with memchr, which goes through the mapping many bytes at a time. Words are separated by any run of
+	 * spaces or tabs, and a # starts a comment which runs to the end of the line. Lines with no words at all are skipped.
+	 * Only the first mxw words are put in w, but they all get counted. With gzip input the slices only last until the next call. */
+	char *p, *le, *ws;
+	int nw;
+	if( (mf->mpd) && (mf->p - mf->rl > RLSZ) ) { /* page cache of what's been read is no longer needed, so RSS stays flat */
+		madvise(mf->rl, RLSZ, MADV_DONTNEED);
+		mf->rl += RLSZ;
+	}
+	while( (mf->p < mf->e) || (mfrefill(mf)) ) {
+		p=mf->p;
+		le=memchr(p, '\n', mf->e-p);
+		if( (!le) && (mfrefill(mf)) ) /* the line runs on into what's still to be inflated */
+			continue;
+		if(!le)
+			le=mf->e; /* last line had no newline */
+		mf->p=le+1;
+		nw=0;
+		while(p<le) {
+			if( (*p==' ') | (*p=='\t') | (*p=='\r') ) {
+				p++;
 				continue;
-			} else if(c=='\n') { /* end of a line */
-				if(wa->numl == wa->lbuf-1) { /* enought space in our current array? */
-					wa->lbuf += WBUF;
-					wa->wpla=realloc(wa->wpla, wa->lbuf*sizeof(size_t));
-					rmf=realloc(rmf, wa->lbuf*sizeof(rmf_t));
-					memset(wa->wpla+(wa->lbuf-WBUF), 0, WBUF*sizeof(size_t));
-				}
-				wa->wpla[wa->numl] = couw-oldcouw; /* number of words in current line */
-				oldcouw=couw; /* restart words per line count */
-				wa->numl++; /* brand new line coming up */
 			}
-			inword=0;
-		} else if(inword==0) { /* deal with first character of new word, + and - also allowed */
-			if(couw == wa->wsbuf-1) {
-				wa->wsbuf += GBUF;
-				wa->wln=realloc(wa->wln, wa->wsbuf*sizeof(size_t));
-				rmf=realloc(rmf, wa->wsbuf*sizeof(rmf_t));
-				for(i=wa->wsbuf-GBUF;i<wa->wsbuf;++i)
-					wa->wln[i]=0;
-			}
-			couc=0;
-			bwbuf=WBUF;
-			bufword=realloc(bufword, bwbuf*sizeof(char)); /* don't bother with memset, it's not necessary */
-			bufword[couc++]=c; /* no need to check here, it's the first character */
-			inword=1;
-		} else {
-			if(couc == bwbuf-1) { /* the -1 so that we can always add and extra (say 0) when we want */
-				bwbuf += WBUF;
-				bufword = realloc(bufword, bwbuf*sizeof(char));
+			if(*p=='#')
+				break;
+			ws=p;
+			while( (p<le) && (*p!=' ') && (*p!='\t') && (*p!='\r') && (*p!='#') )
+				p++;
+			if(nw<mxw) {
+				w[nw].s=ws;
+				w[nw].l=p-ws;
 			}
-			bufword[couc++]=c;
+			nw++;
 		}
+		if(nw) {
+			mf->nl++;
+			return nw;
+		}
+	}
+	return -1;
+}
 
-	} /* end of big for statement */
-	fclose(fp);
-	free(bufword);
+ar_t *create_ar(void)
+{
+	ar_t *ar=calloc(1, sizeof(ar_t));
+	ar->bb=GBUF;
+	ar->bk=malloc(ar->bb*sizeof(char*));
+	return ar;
+}
 
-	/* normalization stage */
-	wa->quan=couw;
-	wa->wln = realloc(wa->wln, wa->quan*sizeof(size_t)); /* normalize */
-	rmf = realloc(rmf, wa->quan*sizeof(rmf_t)); /* normalize */
-	wa->wpla= realloc(wa->wpla, wa->numl*sizeof(size_t));
-
-	*m= wa->numl;
-	int k=wa->wpla[0];
-	for(i=1;i<wa->numl;++i)
-		if(k != wa->wpla[i])
-			printf("Warning: Numcols is not uniform at %i words per line on all lines. This file has one with %zu.\n", k, wa->wpla[i]); 
-	*n= k; 
-	free_wseq(wa);
+void free_ar(ar_t *ar)
+{
+	int i;
+	for(i=0;i<ar->nb;++i)
+		free(ar->bk[i]);
+	mafree(MA_STR, ar->tz);
+	free(ar->bk);
+	if(ar->mp)
+		munmap(ar->mp, ar->mpsz);
+	free(ar);
+}
 
-	return rmf;
+char *aralloc(ar_t *ar, size_t sz) /* sz bytes from the arena */
+{
+	if( (!ar->nb) || (ar->u+sz > ar->bsz) ) { /* a new block */
+		CONDREALLOC(ar->nb, ar->bb, GBUF, ar->bk, char*);
+		ar->bsz=(!ar->nb)? AR0 : (ar->bsz<ARMX)? 2*ar->bsz : ARMX;
+		if(ar->bsz<sz)
+			ar->bsz=sz;
+		ar->bk[ar->nb++]=malloc(ar->bsz);
+		macnt(MA_STR, ar->bsz);
+		ar->tz += ar->bsz;
+		ar->u=0;
+	}
+	ar->u += sz;
+	return ar->bk[ar->nb-1]+ar->u-sz;
 }
 
-dpf_t *processdpf(char *fname, int *m, int *n) /*fourth column is string, other columns to be ignored */
+char *sl2s(sl_t *w, size_t *sz, ar_t *ar) /* copy a slice out into the arena as a string, sz gets the size including the null */
 {
-	/* In order to make no assumptions, the file is treated as lines containing the same amount of words each,
-	 * except for lines starting with #, which are ignored (i.e. comments). These words are checked to make sure they contain only floating number-type
-	 * characters [0123456789+-.] only, one string variable is continually written over and copied into a growing floating point array each time */
+	char *s=aralloc(ar, w->l+1);
+	memcpy(s, w->s, w->l);
+	s[w->l]='\0';
+	*sz=w->l+1;
+	return s;
+}
 
-	/* declarations */
-	FILE *fp=fopen(fname,"r");
-	int i;
-	size_t couc /*count chars per line */, couw=0 /* count words */, oldcouw = 0;
-	int c;
-	boole inword=0;
-	wseq_t *wa=create_wseq_t(GBUF);
-	size_t bwbuf=WBUF;
-	char *bufword=calloc(bwbuf, sizeof(char)); /* this is the string we'll keep overwriting. */
-
-	dpf_t *dpf=malloc(GBUF*sizeof(dpf_t));
-
-	while( (c=fgetc(fp)) != EOF) { /* grab a char */
-		if( (c== '\n') | (c == ' ') | (c == '\t') | (c=='#')) { /* word closing events */
-			if( inword==1) { /* first word closing event */
-				wa->wln[couw]=couc;
-				bufword[couc++]='\0';
-				bufword = realloc(bufword, couc*sizeof(char)); /* normalize */
-				/* for the struct, we want to know if it's the first word in a line, like so: */
-				if(couw==oldcouw) {
-					dpf[wa->numl].n=malloc(couc*sizeof(char));
-					dpf[wa->numl].nsz=couc;
-					strcpy(dpf[wa->numl].n, bufword);
-				} else if((couw-oldcouw)==1) /* it's not the first word, and it's 1st and second col */
-					dpf[wa->numl].p=atol(bufword);
-				else if((couw-oldcouw)==2) /* it's not the first word, and it's 1st and second col */
-					dpf[wa->numl].d=atoi(bufword);
-				couc=0;
-				couw++;
-			}
-			if(c=='#') { /* comment case */
-				while( (c=fgetc(fp)) != '\n') ;
-				continue;
-			} else if(c=='\n') { /* end of a line */
-				if(wa->numl == wa->lbuf-1) { /* enought space in our current array? */
-					wa->lbuf += WBUF;
-					wa->wpla=realloc(wa->wpla, wa->lbuf*sizeof(size_t));
-					dpf=realloc(dpf, wa->lbuf*sizeof(bgr_t));
-					memset(wa->wpla+(wa->lbuf-WBUF), 0, WBUF*sizeof(size_t));
-				}
-				wa->wpla[wa->numl] = couw-oldcouw; /* number of words in current line */
-				oldcouw=couw; /* restart words per line count */
-				wa->numl++; /* brand new line coming up */
-			}
-			inword=0;
-		} else if(inword==0) { /* deal with first character of new word, + and - also allowed */
-			if(couw == wa->wsbuf-1) {
-				wa->wsbuf += GBUF;
-				wa->wln=realloc(wa->wln, wa->wsbuf*sizeof(size_t));
-				dpf=realloc(dpf, wa->wsbuf*sizeof(dpf_t));
-				for(i=wa->wsbuf-GBUF;i<wa->wsbuf;++i)
-					wa->wln[i]=0;
-			}
-			couc=0;
-			bwbuf=WBUF;
-			bufword=realloc(bufword, bwbuf*sizeof(char)); /* don't bother with memset, it's not necessary */
-			bufword[couc++]=c; /* no need to check here, it's the first character */
-			inword=1;
-		} else {
-			if(couc == bwbuf-1) { /* the -1 so that we can always add and extra (say 0) when we want */
-				bwbuf += WBUF;
-				bufword = realloc(bufword, bwbuf*sizeof(char));
-			}
-			bufword[couc++]=c;
-		}
+long sl2l(sl_t *w) /* atol() on a slice */
+{
+	char *p=w->s, *e=w->s+w->l;
+	boole neg=0;
+	long v=0;
+	if( (p<e) && ((*p=='-') | (*p=='+')) )
+		neg=(*p++=='-');
+	while( (p<e) && (*p>='0') && (*p<='9') )
+		v=10*v+(*p++-'0');
+	return neg? -v : v;
+}
 
-	} /* end of big for statement */
-	fclose(fp);
-	free(bufword);
+float sl2f(sl_t *w) /* atof() on a slice */
+{
+	/* plain decimals with up to 15 significant digits are exact as an integer over a power of ten, so one division gives
+	 * the same correctly rounded result as strtod(). Anything fancier (exponents, inf, long mantissas) goes to strtod() on a copy. */
+	static const double p10[]={1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+	char *p=w->s, *e=w->s+w->l;
+	char tbuf[64];
+	boole neg=0;
+	unsigned long mant=0;
+	int nd=0, nfd=0;
+	if( (p<e) && ((*p=='-') | (*p=='+')) )
+		neg=(*p++=='-');
+	while( (p<e) && (*p>='0') && (*p<='9') ) {
+		mant=10*mant+(*p++-'0');
+		nd++;
+	}
+	if( (p<e) && (*p=='.') ) {
+		p++;
+		while( (p<e) && (*p>='0') && (*p<='9') ) {
+			mant=10*mant+(*p++-'0');
+			nfd++;
+		}
+	}
+	if( (p==e) && (nd+nfd>0) && (nd+nfd<=15) )
+		return neg? -(mant/p10[nfd]) : mant/p10[nfd];
 
-	/* normalization stage */
-	wa->quan=couw;
-	wa->wln = realloc(wa->wln, wa->quan*sizeof(size_t)); /* normalize */
-	dpf = realloc(dpf, wa->quan*sizeof(dpf_t)); /* normalize */
-	wa->wpla= realloc(wa->wpla, wa->numl*sizeof(size_t));
+	size_t l=(w->l<sizeof(tbuf))? w->l : sizeof(tbuf)-1;
+	memcpy(tbuf, w->s, l);
+	tbuf[l]='\0';
+	return atof(tbuf);
+}
 
-	*m= wa->numl;
-	int k=wa->wpla[0];
-	for(i=1;i<wa->numl;++i)
-		if(k != wa->wpla[i])
-			printf("Warning: Numcols is not uniform at %i words per line on all lines. This file has one with %zu.\n", k, wa->wpla[i]); 
-	*n= k; 
-	free_wseq(wa);
+ob_t *create_ob(int fd) /* output buffer for fd. Anything printf() has waiting goes out first, so the order is kept */
+{
+	ob_t *ob=calloc(1, sizeof(ob_t));
+	fflush(stdout);
+	ob->fd=fd;
+	ob->b=malloc(OBSZ);
+	return ob;
+}
 
-	return dpf;
+void obflush(ob_t *ob)
+{
+	char *p=ob->b;
+	ssize_t r;
+	while(ob->z) {
+		if( (r=write(ob->fd, p, ob->z)) < 1) {
+			fprintf(stderr, "Error: cannot write the output.\n");
+			exit(EXIT_FAILURE);
+		}
+		p += r;
+		ob->z -= r;
+	}
+	return;
 }
 
-gf_t *processgf(char *fname, int *m, int *n) /* read in a genome file */
+void free_ob(ob_t *ob) /* flushes it first */
 {
-	/* In order to make no assumptions, the file is treated as lines containing the same amount of words each,
-	 * except for lines starting with #, which are ignored (i.e. comments). These words are checked to make sure they contain only floating number-type
-	 * characters [0123456789+-.] only, one string variable is continually written over and copied into a growing floating point array each time */
+	obflush(ob);
+	free(ob->b);
+	free(ob);
+}
 
-	/* declarations */
-	FILE *fp=fopen(fname,"r");
-	int i;
-	size_t couc /*count chars per line */, couw=0 /* count words */, oldcouw = 0;
-	int c;
-	boole inword=0;
-	wseq_t *wa=create_wseq_t(GBUF);
-	size_t bwbuf=WBUF;
-	char *bufword=calloc(bwbuf, sizeof(char)); /* this is the string we'll keep overwriting. */
-
-	gf_t *gf=malloc(GBUF*sizeof(gf_t));
-
-	while( (c=fgetc(fp)) != EOF) { /* grab a char */
-		if( (c== '\n') | (c == ' ') | (c == '\t') | (c=='#')) { /* word closing events */
-			if( inword==1) { /* first word closing event */
-				wa->wln[couw]=couc;
-				bufword[couc++]='\0';
-				bufword = realloc(bufword, couc*sizeof(char)); /* normalize */
-				/* for the struct, we want to know if it's the first word in a line, like so: */
-				if(couw==oldcouw) {
-					gf[wa->numl].n=malloc(couc*sizeof(char));
-					gf[wa->numl].nsz=couc;
-					strcpy(gf[wa->numl].n, bufword);
-				} else if((couw-oldcouw)==1) /* it's not the first word, and it's 1st and second col */
-					gf[wa->numl].z=atol(bufword);
-				couc=0;
-				couw++;
-			}
-			if(c=='#') { /* comment case */
-				while( (c=fgetc(fp)) != '\n') ;
-				continue;
-			} else if(c=='\n') { /* end of a line */
-				if(wa->numl == wa->lbuf-1) { /* enought space in our current array? */
-					wa->lbuf += WBUF;
-					wa->wpla=realloc(wa->wpla, wa->lbuf*sizeof(size_t));
-					gf=realloc(gf, wa->lbuf*sizeof(bgr_t));
-					memset(wa->wpla+(wa->lbuf-WBUF), 0, WBUF*sizeof(size_t));
-				}
-				wa->wpla[wa->numl] = couw-oldcouw; /* number of words in current line */
-				oldcouw=couw; /* restart words per line count */
-				wa->numl++; /* brand new line coming up */
-			}
-			inword=0;
-		} else if(inword==0) { /* deal with first character of new word, + and - also allowed */
-			if(couw == wa->wsbuf-1) {
-				wa->wsbuf += GBUF;
-				wa->wln=realloc(wa->wln, wa->wsbuf*sizeof(size_t));
-				gf=realloc(gf, wa->wsbuf*sizeof(gf_t));
-				for(i=wa->wsbuf-GBUF;i<wa->wsbuf;++i)
-					wa->wln[i]=0;
-			}
-			couc=0;
-			bwbuf=WBUF;
-			bufword=realloc(bufword, bwbuf*sizeof(char)); /* don't bother with memset, it's not necessary */
-			bufword[couc++]=c; /* no need to check here, it's the first character */
-			inword=1;
-		} else {
-			if(couc == bwbuf-1) { /* the -1 so that we can always add and extra (say 0) when we want */
-				bwbuf += WBUF;
-				bufword = realloc(bufword, bwbuf*sizeof(char));
-			}
-			bufword[couc++]=c;
+void obs(ob_t *ob, char *s, size_t l) /* l bytes of s */
+{
+	if(ob->z + l > OBSZ) {
+		obflush(ob);
+		if(l > OBSZ) { /* too big to buffer */
+			char *b=ob->b;
+			ob->b=s;
+			ob->z=l;
+			obflush(ob);
+			ob->b=b;
+			return;
 		}
+	}
+	memcpy(ob->b + ob->z, s, l);
+	ob->z += l;
+	return;
+}
 
-	} /* end of big for statement */
-	fclose(fp);
-	free(bufword);
+void obstr(ob_t *ob, char *s) /* a string, (null) if there isn't one, as printf() does */
+{
+	if(!s)
+		s="(null)";
+	obs(ob, s, strlen(s));
+}
 
-	/* normalization stage */
-	wa->quan=couw;
-	wa->wln = realloc(wa->wln, wa->quan*sizeof(size_t)); /* normalize */
-	gf = realloc(gf, wa->quan*sizeof(gf_t)); /* normalize */
-	wa->wpla= realloc(wa->wpla, wa->numl*sizeof(size_t));
-
-	*m= wa->numl;
-	int k=wa->wpla[0];
-	for(i=1;i<wa->numl;++i)
-		if(k != wa->wpla[i])
-			printf("Warning: Numcols is not uniform at %i words per line on all lines. This file has one with %zu.\n", k, wa->wpla[i]); 
-	*n= k; 
-	free_wseq(wa);
+void obc(ob_t *ob, char c)
+{
+	if(ob->z == OBSZ)
+		obflush(ob);
+	ob->b[ob->z++]=c;
+}
 
-	return gf;
+void obl(ob_t *ob, long v) /* as %li */
+{
+	char t[24], *p=t+sizeof(t);
+	unsigned long u=(v<0)? -(unsigned long)v : (unsigned long)v;
+	do
+		*--p='0'+u%10;
+	while(u /= 10);
+	if(v<0)
+		*--p='-';
+	obs(ob, p, t+sizeof(t)-p);
 }
 
-void prtbd2ia(bgr_t2 *bed2, int n, ia_t *ia)
+void obf(ob_t *ob, double v, int pr) /* as %.prf (pr up to 9), the same digits printf() gives */
 {
-	int i, j;
-	for(i=0;i<ia->z;++i) {
-		for(j=0;j<n;++j) {
-			if(j==0)
-				printf("%s ", bed2[ia->a[i]].n);
-			else if(j==3)
-				printf("%s ", bed2[ia->a[i]].f);
-			else
-				printf("%li ", bed2[ia->a[i]].c[j-1]);
-			}
-			printf("\n"); 
+	/* Scaled up by 10^pr and rounded, which only differs from printf()'s exact decimal rounding when the scaled value is
+	 * within the multiplication's error of a half. Those, and values too big for the integer part, go through snprintf() */
+	static const double p10[]={1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9};
+	char t[DBL_MAX_10_EXP+16], *p=t+sizeof(t); /* room for -DBL_MAX to 9 places, so snprintf() never cuts it short */
+	double x=fabs(v)*p10[pr], fr;
+	unsigned long long u, ip;
+	int k;
+	if( (!isfinite(v)) || (x >= 1e15) ) {
+		obs(ob, t, snprintf(t, sizeof(t), "%.*f", pr, v));
+		return;
 	}
-	return;
+	u=(unsigned long long)x;
+	fr=x-(double)u;
+	if(fabs(fr-.5) <= x*0x1p-50+0x1p-60) {
+		obs(ob, t, snprintf(t, sizeof(t), "%.*f", pr, v));
+		return;
+	}
+	if(fr > .5)
+		u++;
+	ip=u/(unsigned long long)p10[pr];
+	u -= ip*(unsigned long long)p10[pr];
+	for(k=0;k<pr;++k) {
+		*--p='0'+u%10;
+		u /= 10;
+	}
+	if(pr)
+		*--p='.';
+	do
+		*--p='0'+ip%10;
+	while(ip /= 10);
+	if(signbit(v))
+		*--p='-';
+	obs(ob, p, t+sizeof(t)-p);
 }
 
-void prtrmf(char *fname, rmf_t *rmf, int m6)
+void chkncols(int *k, int nw) /* warn when the number of words per line isn't the same as on the first line */
 {
-	int i;
-	for(i=0;i<m6;++i) // note how we cut out the spurious parts of the motif string to leave it pure and raw (slightly weird why two-char deletion is necessary.
-		printf("%s\t%li\t%li\t%c\t%.*s\n", rmf[i].n, rmf[i].c[0], rmf[i].c[1], rmf[i].sd, (int)(rmf[i].msz-9), rmf[i].m+7);
-
-	printf("You just seen the %i entries of repeatmasker gff2 file called \"%s\".\n", m6, fname); 
+	if(*k==-1)
+		*k=nw;
+	else if(*k != nw)
+		printf("Warning: Numcols is not uniform at %i words per line on all lines. This file has one with %i.\n", *k, nw); 
 	return;
 }
 
-void bed2in2(char *bed2fn, bgr_t2 *bed2, int m, int n, ia_t *ia) // split into 2 files
+cd_t *create_cd(void)
 {
-	int i, j, k=0;
-	size_t lfn=strlen(bed2fn);
-	char *outfn1=calloc(4+lfn ,sizeof(char));
-	char *outfn2=calloc(4+lfn, sizeof(char));
+	cd_t *cd=calloc(1, sizeof(cd_t));
+	cd->b=GBUF;
+	cd->n=malloc(cd->b*sizeof(char*));
+	cd->nsz=malloc(cd->b*sizeof(size_t));
+	cd->htz=64;
+	cd->ht=malloc(cd->htz*sizeof(int));
+	memset(cd->ht, -1, cd->htz*sizeof(int));
+	cd->lk=-1;
+	macnt(MA_IDX, cd->b*(sizeof(char*)+sizeof(size_t)) + cd->htz*sizeof(int));
+	return cd;
+}
+
+void free_cd(cd_t *cd)
+{
+	int i;
+	size_t z=0;
+	for(i=0;i<cd->z;++i) {
+		z += cd->nsz[i];
+		free(cd->n[i]);
+	}
+	mafree(MA_STR, z);
+	mafree(MA_IDX, cd->b*(sizeof(char*)+sizeof(size_t)) + cd->htz*sizeof(int));
+	free(cd->n);
+	free(cd->nsz);
+	free(cd->ht);
+	free(cd);
+}
+
+unsigned hashsl(char *s, size_t l) /* FNV-1a hash of l bytes */
+{
+	unsigned h=2166136261u;
+	size_t i;
+	for(i=0;i<l;++i)
+		h=(h^(unsigned char)s[i])*16777619u;
+	return h;
+}
+
+int cdid(cd_t *cd, char *s, size_t l) /* the id of chromosome name s, of length l. It gets added if it's new */
+{
+	unsigned i, j;
+	int k;
+	if( (cd->lk != -1) && (cd->nsz[cd->lk]==l+1) && (!memcmp(cd->n[cd->lk], s, l)) )
+		return cd->lk;
+	for(i=hashsl(s, l)&(cd->htz-1); (k=cd->ht[i]) != -1; i=(i+1)&(cd->htz-1))
+		if( (cd->nsz[k]==l+1) && (!memcmp(cd->n[k], s, l)) )
+			return cd->lk=k;
+
+	/* a new one */
+	if(cd->z == cd->b) {
+		cd->b += GBUF;
+		cd->n=realloc(cd->n, cd->b*sizeof(char*));
+		cd->nsz=realloc(cd->nsz, cd->b*sizeof(size_t));
+		macnt(MA_IDX, GBUF*(sizeof(char*)+sizeof(size_t)));
+	}
+	k=cd->z++;
+	cd->n[k]=malloc((l+1)*sizeof(char));
+	macnt(MA_STR, l+1);
+	memcpy(cd->n[k], s, l);
+	cd->n[k][l]='\0';
+	cd->nsz[k]=l+1;
+	cd->ht[i]=k;
+	if((unsigned)(2*cd->z) > cd->htz) { /* keep it at most half full */
+		cd->htz *= 2;
+		cd->ht=realloc(cd->ht, cd->htz*sizeof(int));
+		macnt(MA_IDX, cd->htz/2*sizeof(int));
+		memset(cd->ht, -1, cd->htz*sizeof(int));
+		for(k=0;k<cd->z;++k) {
+			for(j=hashsl(cd->n[k], cd->nsz[k]-1)&(cd->htz-1); cd->ht[j] != -1; j=(j+1)&(cd->htz-1))
+				;
+			cd->ht[j]=k;
+		}
+	}
+	return cd->lk=cd->z-1;
+}
+
+words_t *processwordf(char *fname, size_t *m, int *n, ar_t *ar)
+{
+	/* In order to make no assumptions, the file is treated as lines containing the same amount of words each,
+	 * except for lines starting with #, which are ignored (i.e. comments). Words arrive as slices of the mapped file,
+	 * and only the first word on each line gets copied out, into the file's arena */
+
+	/* declarations */
+	mf_t *mf=mfopen(fname);
+	sl_t w[MXWPL];
+	int nw, k=-1;
+	size_t numl=0, lbuf=GBUF;
+	words_t *bedword=calloc(lbuf, sizeof(words_t));
+
+	while( (nw=mfnxtl(mf, w, MXWPL)) != -1) {
+		if(nw >4) {
+			printf("Error, each row cannot exceed 4 words: revise your input file\n"); 
+			mfclose(mf);
+			exit(EXIT_FAILURE);
+		}
+		CONDREALLOC(numl, lbuf, GBUF, bedword, words_t);
+		bedword[numl].n=sl2s(w, &bedword[numl].nsz, ar);
+		chkncols(&k, nw);
+		numl++;
+	}
+	mfclose(mf);
+
+	/* normalization stage */
+	bedword = realloc(bedword, numl*sizeof(words_t)); /* normalize */
+	macnt(MA_ROWS, numl*sizeof(words_t));
+	*m= numl;
+	*n= (k==-1)? 0 : k; 
+
+	return bedword;
+}
+
+ws_t *create_ws(words_t *w, size_t m) /* hash set of the m words in w */
+{
+	size_t k;
+	unsigned i;
+	ws_t *ws=calloc(1, sizeof(ws_t));
+	ws->w=w;
+	ws->htz=64;
+	while(ws->htz < 2*m) /* at most half full */
+		ws->htz *= 2;
+	ws->ht=malloc(ws->htz*sizeof(int));
+	macnt(MA_IDX, ws->htz*sizeof(int));
+	memset(ws->ht, -1, ws->htz*sizeof(int));
+	for(k=0;k<m;++k) {
+		for(i=hashsl(w[k].n, w[k].nsz-1)&(ws->htz-1); ws->ht[i] != -1; i=(i+1)&(ws->htz-1))
+			if( (w[ws->ht[i]].nsz==w[k].nsz) && (!memcmp(w[ws->ht[i]].n, w[k].n, w[k].nsz)) )
+				break; /* repeated in the list */
+		ws->ht[i]=k;
+	}
+	return ws;
+}
+
+void free_ws(ws_t *ws)
+{
+	mafree(MA_IDX, ws->htz*sizeof(int));
+	free(ws->ht);
+	free(ws);
+}
+
+boole wsin(ws_t *ws, char *s, size_t l) /* is s, of length l, in the set */
+{
+	unsigned i;
+	int k;
+	for(i=hashsl(s, l)&(ws->htz-1); (k=ws->ht[i]) != -1; i=(i+1)&(ws->htz-1))
+		if( (ws->w[k].nsz==l+1) && (!memcmp(ws->w[k].n, s, l)) )
+			return 1;
+	return 0;
+}
+
+bgc_t *create_bgc(size_t b)
+{
+	bgc_t *bg=calloc(1, sizeof(bgc_t));
+	bg->b=b;
+	bg->ci=malloc(b*sizeof(int));
+	bg->st=calloc(b, sizeof(long));
+	bg->en=calloc(b, sizeof(long));
+	bg->co=calloc(b, sizeof(float));
+	macnt(MA_ROWS, b*(sizeof(int)+2*sizeof(long)+sizeof(float)));
+	return bg;
+}
+
+void bgcsz(bgc_t *bg, size_t b) /* resize the columns to b rows */
+{
+	mafree(MA_ROWS, bg->b*(sizeof(int)+2*sizeof(long)+sizeof(float)));
+	macnt(MA_ROWS, b*(sizeof(int)+2*sizeof(long)+sizeof(float)));
+	bg->b=b;
+	bg->ci=realloc(bg->ci, b*sizeof(int));
+	bg->st=realloc(bg->st, b*sizeof(long));
+	bg->en=realloc(bg->en, b*sizeof(long));
+	bg->co=realloc(bg->co, b*sizeof(float));
+	return;
+}
+
+void free_bgc(bgc_t *bg)
+{
+	if(!bg->mci)
+		free(bg->ci);
+	if(bg->mp)
+		munmap(bg->mp, bg->mpsz);
+	else {
+		mafree(MA_ROWS, bg->b*(sizeof(int)+2*sizeof(long)+sizeof(float)));
+		free(bg->st);
+		free(bg->en);
+		free(bg->co);
+	}
+	free(bg);
+}
+
+void *pjthrd(void *v) /* a thread of the pool: does parts until there are none left */
+{
+	pj_t *pj=v;
+	int g;
+	for(;;) {
+		pthread_mutex_lock(&pj->mx);
+		g=pj->nxt++;
+		pthread_mutex_unlock(&pj->mx);
+		if(g>=pj->np)
+			break;
+		pj->f(pj->a, g);
+	}
+	return NULL;
+}
+
+void pjrun(void (*f)(void *a, int g), void *a, int np, int nt) /* do parts 0 to np-1 of a job on nt threads, back when they're all done */
+{
+	/* parts must not write to anything another part does, then the result is the same however they're shared out */
+	int i;
+	if( (nt<=1) || (np<=1) ) {
+		for(i=0;i<np;++i)
+			f(a, i);
+		return;
+	}
+	if(nt>np)
+		nt=np;
+	pthread_t *th=malloc(nt*sizeof(pthread_t));
+	pj_t pj;
+	memset(&pj, 0, sizeof(pj_t));
+	pj.f=f;
+	pj.a=a;
+	pj.np=np;
+	pthread_mutex_init(&pj.mx, NULL);
+	for(i=0;i<nt;++i)
+		pthread_create(th+i, NULL, pjthrd, &pj);
+	for(i=0;i<nt;++i)
+		pthread_join(th[i], NULL);
+	pthread_mutex_destroy(&pj.mx);
+	free(th);
+	return;
+}
+
+size_t *gpart(void *a, size_t sz, size_t m, int ng, size_t **gs) /* split m records of sz bytes by chromosome id, which has to be their first member */
+{
+	/* returns the records' indices grouped by chromosome and otherwise in their own order. gs gets where each chromosome's begin,
+	 * there are ng+1 of them */
+	size_t i, *ix=malloc((m+1)*sizeof(size_t)), *s=calloc(ng+2, sizeof(size_t));
+	int g;
+	for(i=0;i<m;++i)
+		s[*(int*)((char*)a+i*sz)+2]++;
+	for(g=2;g<ng+2;++g)
+		s[g]+=s[g-1];
+	for(i=0;i<m;++i)
+		ix[s[*(int*)((char*)a+i*sz)+1]++]=i;
+	*gs=s;
+	macnt(MA_IDX, (m+ng+3)*sizeof(size_t));
+	return ix;
+}
+
+void free_gpart(size_t *ix, size_t *gs, size_t m, int ng) /* what gpart() gave for m records and ng chromosome ids */
+{
+	mafree(MA_IDX, (m+ng+3)*sizeof(size_t));
+	free(ix);
+	free(gs);
+}
+
+void pfchunk(void *v, int k) /* parse chunk k */
+{
+	pf_t *pf=v;
+	pc_t *pc=pf->pc+k;
+	sl_t w[MXWPL];
+	int nw;
+	boole x;
+	pc->k0=-1;
+	while( (nw=mfnxtl(pc->mf, w, MXWPL)) != -1) {
+		if(pc->m == pc->b) {
+			macnt(MA_ROWS, ((pc->b)? pc->b : GBUF*GBUF)*pf->rsz);
+			pc->b=(pc->b)? 2*pc->b : GBUF*GBUF;
+			pc->r=realloc(pc->r, pc->b*pf->rsz);
+		}
+		if(!(x=pf->f(pc, w, nw, pc->r+pc->m*pf->rsz))) {
+			pc->bad=1;
+			break;
+		}
+		if(pc->k0==-1)
+			pc->k0=nw;
+		else if(nw != pc->k0) { /* kept for chkncols() to go through once the chunks are put together */
+			if(pc->nx == pc->bx) {
+				pc->bx=(pc->bx)? 2*pc->bx : GBUF;
+				pc->xl=realloc(pc->xl, pc->bx*sizeof(size_t));
+				pc->xn=realloc(pc->xn, pc->bx*sizeof(int));
+			}
+			pc->xl[pc->nx]=pc->nl;
+			pc->xn[pc->nx++]=nw;
+		}
+		if(x==1)
+			pc->m++;
+		pc->nl++;
+	}
+	return;
+}
+
+pf_t *pfparse(char *fname, size_t rsz, boole (*f)(pc_t*, sl_t*, int, char*), char *emsg, int *n, cd_t *cd, ar_t *ar, int nt)
+{
+	/* The file is cut into nt byte ranges, each moved on to the start of a line, so comments and blank lines are dealt with as
+	 * they always are. Each chunk is parsed on its own thread, with its own chromosome names and strings. Then, going through the
+	 * chunks in order, their names go into cd, which gives them the ids they'd have had from one pass, and the ids in their rows
+	 * (always the rows' first member) are changed to those. The warnings and any error come out as they would have from one pass too.
+	 * Compressed files and small ones are one chunk. emsg is what a line f can't take gets. The rows are left in the chunks */
+	int i, g, k=-1;
+	size_t j, x, z;
+	char *q;
+	pf_t *pf=calloc(1, sizeof(pf_t));
+	pf->rsz=rsz;
+	pf->f=f;
+	pf->mf=mfopen(fname);
+	pf->nk=( (pf->mf->gz) || (nt<=1) || (pf->mf->sz < PCMIN) )? 1 : nt;
+	pf->pc=calloc(pf->nk, sizeof(pc_t));
+	if(pf->nk==1)
+		pf->pc[0].mf=pf->mf;
+	else {
+		long pg=sysconf(_SC_PAGESIZE);
+		for(i=0, q=pf->mf->d;i<pf->nk;++i) {
+			mf_t *cm=pf->pc[i].mf=malloc(sizeof(mf_t));
+			*cm=*pf->mf;
+			cm->p=q;
+			if(i<pf->nk-1) {
+				q=pf->mf->d + (pf->mf->sz/pf->nk)*(i+1);
+				if(q<cm->p)
+					q=cm->p;
+				q=memchr(q, '\n', pf->mf->e-q);
+				q=(q)? q+1 : pf->mf->e;
+			} else
+				q=pf->mf->e;
+			cm->e=q;
+			cm->rl=(char*)(((size_t)cm->p + pg-1) & ~(size_t)(pg-1)); /* pages are handed back from here, so never any of the chunk before */
+		}
+	}
+	for(i=0;i<pf->nk;++i) {
+		pf->pc[i].cd=create_cd();
+		pf->pc[i].ar=(ar)? create_ar() : NULL;
+	}
+	pjrun(pfchunk, pf, pf->nk, nt);
+	if(pf->nk>1)
+		for(i=0;i<pf->nk;++i)
+			pf->mf->nl += pf->pc[i].mf->nl;
+
+	for(i=0;i<pf->nk;++i) {
+		pc_t *pc=pf->pc+i;
+		int *tr=malloc((pc->cd->z+1)*sizeof(int));
+		boole same=1;
+		for(g=0;g<pc->cd->z;++g) {
+			tr[g]=cdid(cd, pc->cd->n[g], pc->cd->nsz[g]-1);
+			if(tr[g]!=g)
+				same=0;
+		}
+		if(!same)
+			for(j=0;j<pc->m;++j)
+				*(int*)(pc->r+j*rsz)=tr[*(int*)(pc->r+j*rsz)];
+		free(tr);
+		if( (pc->m) || (pc->bad) ) { /* warnings, as chkncols() would give, a line at a time */
+			if(k==-1)
+				k=(pc->m)? pc->k0 : -1;
+			if(pc->k0==k) {
+				for(x=0;x<pc->nx;++x)
+					chkncols(&k, pc->xn[x]);
+			} else
+				for(j=0,x=0;j<pc->nl;++j) {
+					z=( (x<pc->nx) && (pc->xl[x]==j) )? pc->xn[x++] : pc->k0;
+					chkncols(&k, z);
+				}
+		}
+		if(pc->bad) {
+			printf("%s", emsg); 
+			exit(EXIT_FAILURE);
+		}
+		if(ar) { /* its strings' blocks become the file's */
+			for(g=0;g<pc->ar->nb;++g) {
+				CONDREALLOC(ar->nb, ar->bb, GBUF, ar->bk, char*);
+				ar->bk[ar->nb++]=pc->ar->bk[g];
+			}
+			if(pc->ar->nb) {
+				ar->bsz=pc->ar->bsz;
+				ar->u=pc->ar->u;
+			}
+			ar->tz += pc->ar->tz;
+			pc->ar->nb=0;
+			pc->ar->tz=0;
+			free_ar(pc->ar);
+		}
+		free_cd(pc->cd);
+		free(pc->xl);
+		free(pc->xn);
+	}
+	*n=(k==-1)? 0 : k;
+	return pf;
+}
+
+char *pfrows(pf_t *pf, size_t *m) /* the rows of all the chunks, one after the other, and finished with the chunks */
+{
+	int i;
+	char *r;
+	for(i=0, *m=0;i<pf->nk;++i)
+		*m += pf->pc[i].m;
+	macnt(MA_ROWS, (*m+1)*pf->rsz);
+	if(pf->nk==1) {
+		mafree(MA_ROWS, pf->pc[0].b*pf->rsz);
+		r=realloc(pf->pc[0].r, (*m+1)*pf->rsz);
+	} else {
+		r=malloc((*m+1)*pf->rsz);
+		for(i=0, *m=0;i<pf->nk;++i) {
+			memcpy(r+*m*pf->rsz, pf->pc[i].r, pf->pc[i].m*pf->rsz);
+			*m += pf->pc[i].m;
+			mafree(MA_ROWS, pf->pc[i].b*pf->rsz);
+			free(pf->pc[i].r);
+			free(pf->pc[i].mf);
+		}
+	}
+	mfclose(pf->mf);
+	free(pf->pc);
+	free(pf);
+	return r;
+}
+
+boole plbg(pc_t *pc, sl_t *w, int nw, char *r) /* a bedgraph line */
+{
+	bgl_t *b=(bgl_t*)r;
+	if(nw >4)
+		return 0;
+	b->ci=cdid(pc->cd, w[0].s, w[0].l);
+	b->st=(nw>1)? sl2l(w+1) : 0;
+	b->en=(nw>2)? sl2l(w+2) : 0;
+	b->co=(nw>3)? sl2f(w+3) : 0; // assume float
+	return 1;
+}
+
+boole plbed2(pc_t *pc, sl_t *w, int nw, char *r) /* a feature file line */
+{
+	bgr_t2 *b=(bgr_t2*)r;
+	b->ci=cdid(pc->cd, w[0].s, w[0].l);
+	b->c[0]=(nw>1)? sl2l(w+1) : 0;
+	b->c[1]=(nw>2)? sl2l(w+2) : 0;
+	b->fsz=0;
+	b->f=(nw>3)? sl2s(w+3, &b->fsz, pc->ar) : NULL;
+	return 1;
+}
+
+boole pldpf(pc_t *pc, sl_t *w, int nw, char *r) /* a depth file line */
+{
+	/* Next to each other, bases mostly have the same depth, so a line with the depth of the row before and the next position on
+	 * goes into it. Lines with an odd number of words, and the ones after them, are kept as rows of their own for the warnings */
+	dpf_t *b=(dpf_t*)r, *a=b-1;
+	int ci=cdid(pc->cd, w[0].s, w[0].l), d=(nw>2)? (int)sl2l(w+2) : 0;
+	long p=(nw>1)? sl2l(w+1) : 0;
+	if( (pc->m) && (nw==pc->k0) && ((!pc->nx) || (pc->xl[pc->nx-1] != pc->nl-1)) && (a->ci==ci) && (a->d==d) && (a->p+a->n==p) ) {
+		a->n++;
+		return 2;
+	}
+	b->ci=ci;
+	b->d=d;
+	b->p=p;
+	b->n=1;
+	return 1;
+}
+
+bgc_t *processinpf(char *fname, size_t *m, int *n, cd_t *cd, int nt)
+{
+	/* In order to make no assumptions, the file is treated as lines containing the same amount of words each,
+	 * except for lines starting with #, which are ignored (i.e. comments). Words arrive as slices of the mapped file:
+	 * the coordinates and signal are converted straight from the slice, and the name goes into the chromosome dictionary.
+	 * Big files are parsed in nt chunks at once (see pfparse()), then the lines are split out into their columns a chunk at a time */
+	int i;
+	size_t j, z=0;
+	pf_t *pf=pfparse(fname, sizeof(bgl_t), plbg, "Error, each row cannot exceed 4 words: revise your input file\n", n, cd, NULL, nt);
+	for(i=0;i<pf->nk;++i)
+		z += pf->pc[i].m;
+	bgc_t *bg=create_bgc(z+1);
+	for(i=0;i<pf->nk;++i) {
+		bgl_t *b=(bgl_t*)pf->pc[i].r;
+		for(j=0;j<pf->pc[i].m;++j) {
+			bg->ci[bg->m]=b[j].ci;
+			bg->st[bg->m]=b[j].st;
+			bg->en[bg->m]=b[j].en;
+			bg->co[bg->m++]=b[j].co;
+		}
+		mafree(MA_ROWS, pf->pc[i].b*pf->rsz);
+		free(pf->pc[i].r);
+		pf->pc[i].r=NULL;
+		pf->pc[i].m=pf->pc[i].b=0;
+	}
+	free(pfrows(pf, &j));
+	mafree(MA_ROWS, sizeof(bgl_t)); /* pfrows()'s one spare row, all it had left */
+
+	/* normalization stage */
+	bgcsz(bg, bg->m);
+	*m= bg->m;
+
+	return bg;
+}
+
+bgr_t2 *processinpf2(char *fname, size_t *m, int *n, cd_t *cd, ar_t *ar, int nt) /*fourth column is string, other columns to be ignored */
+{
+	/* In order to make no assumptions, the file is treated as lines containing the same amount of words each,
+	 * except for lines starting with #, which are ignored (i.e. comments). Words arrive as slices of the mapped file:
+	 * the coordinates are converted straight from the slice, the feature is copied out into the file's arena.
+	 * Big files are parsed in nt chunks at once, see pfparse() */
+	pf_t *pf=pfparse(fname, sizeof(bgr_t2), plbed2, "", n, cd, ar, nt);
+	return (bgr_t2*)pfrows(pf, m);
+}
+
+char *btkfn(char *fname, int kd, char *sfx) /* name of fname's sidecar of kind kd, with sfx on the end: .btk for parsed files, .bti for indexes */
+{
+	char *cn=malloc(strlen(fname)+strlen(sfx)+5);
+	sprintf(cn, "%s.bt%c%s", fname, (kd==BK_IDX)? 'i' : 'k', sfx);
+	return cn;
+}
+
+size_t btkpad(FILE *fp, size_t o) /* zeros up to the next multiple of 8, so every section is aligned */
+{
+	char z[8]={0};
+	fwrite(z, 1, (8-o%8)%8, fp);
+	return (o+7)&~(size_t)7;
+}
+
+void btkwrite(char *fname, int kd, size_t m, int n, cd_t *cd, int *ci, int nc, void **cs, size_t *csz) /* write fname's sidecar */
+{
+	/* the sidecar has its own chromosome ids, given out in the order the rows first use them, which is the order parsing would
+	 * put them in the dictionary. Then come the ids of the m rows, and nc more columns, cs[k] being csz[k] bytes.
+	 * It is written to a temporary name and moved into place, so a half-written one is never picked up */
+	struct stat sb;
+	size_t i, o, ng=0;
+	int k;
+	if( (stat(fname, &sb)) || (!S_ISREG(sb.st_mode)) ) /* no point for a pipe */
+		return;
+	int *tr=malloc(cd->z*sizeof(int)), *gl=malloc(cd->z*sizeof(int)), *lci=malloc((m+1)*sizeof(int));
+	memset(tr, -1, cd->z*sizeof(int));
+	for(i=0;i<m;++i) {
+		if(tr[ci[i]]==-1) {
+			gl[ng]=ci[i];
+			tr[ci[i]]=ng++;
+		}
+		lci[i]=tr[ci[i]];
+	}
+	char *cn=btkfn(fname, kd, ""), *tn=btkfn(fname, kd, ".tmp");
+	FILE *fp=fopen(tn, "wb");
+	if(!fp) {
+		fprintf(stderr, "Warning: cannot write cache file \"%s\", carrying on without it.\n", cn);
+		goto out;
+	}
+	bh_t h;
+	memset(&h, 0, sizeof(bh_t));
+	memcpy(h.mg, BTKMG, sizeof(h.mg));
+	h.kd=kd;
+	h.n=n;
+	h.srcsz=sb.st_size;
+	h.mts=sb.st_mtim.tv_sec;
+	h.mtns=sb.st_mtim.tv_nsec;
+	h.m=m;
+	h.ng=ng;
+	fwrite(&h, sizeof(bh_t), 1, fp);
+	o=h.o[0]=btkpad(fp, sizeof(bh_t));
+	for(i=0;i<ng;++i) {
+		fwrite(cd->n[gl[i]], 1, cd->nsz[gl[i]], fp);
+		o += cd->nsz[gl[i]];
+	}
+	o=h.o[1]=btkpad(fp, o);
+	fwrite(lci, sizeof(int), m, fp);
+	o += m*sizeof(int);
+	for(k=0;k<nc;++k) {
+		o=h.o[k+2]=btkpad(fp, o);
+		fwrite(cs[k], 1, csz[k], fp);
+		o += csz[k];
+	}
+	h.sz=btkpad(fp, o);
+	fseek(fp, 0, SEEK_SET);
+	fwrite(&h, sizeof(bh_t), 1, fp);
+	if( (ferror(fp)) | (fclose(fp)) || (rename(tn, cn)) ) {
+		fprintf(stderr, "Warning: cannot write cache file \"%s\", carrying on without it.\n", cn);
+		remove(tn);
+	}
+out:
+	free(cn);
+	free(tn);
+	free(tr);
+	free(gl);
+	free(lci);
+	return;
+}
+
+char *btkmap(char *fname, int kd) /* map in fname's sidecar, if it has an up to date one of kind kd, NULL if not */
+{
+	struct stat sb, cb;
+	char *d=NULL, *cn=btkfn(fname, kd, "");
+	bh_t *h;
+	int fd=open(cn, O_RDONLY);
+	free(cn);
+	if( (fd==-1) || (stat(fname, &sb)) ) {
+		if(fd!=-1)
+			close(fd);
+		return NULL;
+	}
+	if( (!fstat(fd, &cb)) && (cb.st_size >= (long)sizeof(bh_t)) ) {
+		d=mmap(NULL, cb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if(d==MAP_FAILED)
+			d=NULL;
+	}
+	close(fd);
+	if(!d)
+		return NULL;
+	h=(bh_t*)d;
+	if( (memcmp(h->mg, BTKMG, sizeof(h->mg))) || (h->kd!=kd) || (h->srcsz!=sb.st_size) || (h->mts!=sb.st_mtim.tv_sec) || (h->mtns!=sb.st_mtim.tv_nsec) || (h->sz!=(size_t)cb.st_size) ) {
+		munmap(d, cb.st_size);
+		return NULL;
+	}
+	return d;
+}
+
+int *btkids(char *d, cd_t *cd, boole *mpd) /* the rows' chromosome ids, after putting the sidecar's names into the dictionary */
+{
+	/* usually the dictionary ends up giving them the same ids as the sidecar, and then the ids in the mapping are used as they are.
+	 * Otherwise (mpd is 0) they're translated into a copy */
+	bh_t *h=(bh_t*)d;
+	size_t i;
+	int *tr=malloc((h->ng+1)*sizeof(int)), *ci=(int*)(d+h->o[1]);
+	char *nm=d+h->o[0];
+	*mpd=1;
+	for(i=0;i<h->ng;++i) {
+		tr[i]=cdid(cd, nm, strlen(nm));
+		if(tr[i]!=(int)i)
+			*mpd=0;
+		nm += strlen(nm)+1;
+	}
+	if(!*mpd) {
+		ci=malloc((h->m+1)*sizeof(int));
+		for(i=0;i<h->m;++i)
+			ci[i]=tr[((int*)(d+h->o[1]))[i]];
+	}
+	free(tr);
+	return ci;
+}
+
+void btkwbgc(char *fname, bgc_t *bg, int n, cd_t *cd) /* sidecar for a bedgraph */
+{
+	void *cs[3]={bg->st, bg->en, bg->co};
+	size_t csz[3]={bg->m*sizeof(long), bg->m*sizeof(long), bg->m*sizeof(float)};
+	btkwrite(fname, BK_BGC, bg->m, n, cd, bg->ci, 3, cs, csz);
+	return;
+}
+
+bgc_t *btkbgc(char *fname, size_t *m, int *n, cd_t *cd) /* bedgraph from its sidecar: the columns stay in the mapping. NULL if there's no up to date one */
+{
+	char *d=btkmap(fname, BK_BGC);
+	if(!d)
+		return NULL;
+	bh_t *h=(bh_t*)d;
+	bgc_t *bg=calloc(1, sizeof(bgc_t));
+	bg->mp=d;
+	bg->mpsz=h->sz;
+	bg->m=bg->b=h->m;
+	bg->ci=btkids(d, cd, &bg->mci);
+	bg->st=(long*)(d+h->o[2]);
+	bg->en=(long*)(d+h->o[3]);
+	bg->co=(float*)(d+h->o[4]);
+	*m=h->m;
+	*n=h->n;
+	return bg;
+}
+
+void btkwbed2(char *fname, bgr_t2 *bed2, size_t m, int n, cd_t *cd) /* sidecar for a feature file */
+{
+	/* the rows are turned into columns, the features going one after the other, each with its null */
+	size_t i, fz=0;
+	int *ci=malloc((m+1)*sizeof(int));
+	long *c0=malloc((m+1)*sizeof(long)), *c1=malloc((m+1)*sizeof(long));
+	size_t *fsz=malloc((m+1)*sizeof(size_t));
+	for(i=0;i<m;++i)
+		fz += bed2[i].fsz;
+	char *f=malloc(fz+1);
+	for(i=0,fz=0;i<m;++i) {
+		ci[i]=bed2[i].ci;
+		c0[i]=bed2[i].c[0];
+		c1[i]=bed2[i].c[1];
+		fsz[i]=bed2[i].fsz;
+		if(bed2[i].f)
+			memcpy(f+fz, bed2[i].f, bed2[i].fsz);
+		fz += bed2[i].fsz;
+	}
+	void *cs[4]={c0, c1, fsz, f};
+	size_t csz[4]={m*sizeof(long), m*sizeof(long), m*sizeof(size_t), fz};
+	btkwrite(fname, BK_BED2, m, n, cd, ci, 4, cs, csz);
+	free(ci);
+	free(c0);
+	free(c1);
+	free(fsz);
+	free(f);
+	return;
+}
+
+bgr_t2 *btkbed2(char *fname, size_t *m, int *n, cd_t *cd, ar_t *ar) /* feature file from its sidecar: the features stay in the mapping, which the arena looks after. NULL if there's no up to date one */
+{
+	size_t i;
+	boole mpd;
+	char *d=btkmap(fname, BK_BED2);
+	if(!d)
+		return NULL;
+	bh_t *h=(bh_t*)d;
+	int *ci=btkids(d, cd, &mpd);
+	long *c0=(long*)(d+h->o[2]), *c1=(long*)(d+h->o[3]);
+	size_t *fsz=(size_t*)(d+h->o[4]);
+	char *f=d+h->o[5];
+	bgr_t2 *bed2=malloc((h->m+1)*sizeof(bgr_t2));
+	macnt(MA_ROWS, (h->m+1)*sizeof(bgr_t2));
+	for(i=0;i<h->m;++i) {
+		bed2[i].ci=ci[i];
+		bed2[i].c[0]=c0[i];
+		bed2[i].c[1]=c1[i];
+		bed2[i].fsz=fsz[i];
+		bed2[i].f=(fsz[i])? f : NULL;
+		f += fsz[i];
+	}
+	if(!mpd)
+		free(ci);
+	ar->mp=d;
+	ar->mpsz=h->sz;
+	*m=h->m;
+	*n=h->n;
+	return bed2;
+}
+
+void ixgs(ix_t *ix, cd_t *cd) /* find where each chromosome's windows begin */
+{
+	size_t i;
+	int g;
+	ix->ng=cd->z;
+	ix->gs=calloc(ix->ng+1, sizeof(size_t));
+	macnt(MA_IDX, (ix->ng+1)*sizeof(size_t));
+	for(i=ix->m;i>0;--i) /* backwards, so each gets its first window */
+		ix->gs[ix->ci[i-1]]=i-1;
+	for(g=0;g<ix->ng;++g) /* ones without windows get an empty run */
+		if( (!ix->m) || (ix->ci[ix->gs[g]]!=g) )
+			ix->gs[g]=ix->m;
+	ix->gs[ix->ng]=ix->m;
+	return;
+}
+
+size_t ixnw(ix_t *ix, int g) /* number of windows chromosome id g has */
+{
+	size_t i=ix->gs[g];
+	if( (g<0) || (g>=ix->ng) || (i==ix->m) )
+		return 0;
+	while( (i<ix->m) && (ix->ci[i]==g) )
+		i++;
+	return i-ix->gs[g];
+}
+
+ix_t *bldix(char *fname, cd_t *cd) /* index fname, which has to be sorted: each chromosome's lines together and in start order */
+{
+	/* a line sets the offset of every window it reaches into that doesn't have one yet. Windows no line reaches into
+	 * get the offset of the next one that does: nothing in them could have come any earlier */
+	size_t i, j, wb=GBUF, ob, m=0;
+	long st, en, w, w0, w1, o, pst=0;
+	int nw, g, cg=-1;
+	sl_t ws[MXWPL];
+	boole *sn=calloc(1, sizeof(boole)); /* chromosomes which have been seen already */
+	int sb=0;
+	mf_t *mf=mfopen(fname);
+	if(mf->gz) {
+		fprintf(stderr, "Error: \"%s\" is compressed, only plain files can be indexed for region queries.\n", fname);
+		exit(EXIT_FAILURE);
+	}
+	ix_t *ix=calloc(1, sizeof(ix_t));
+	ix->ci=malloc(wb*sizeof(int));
+	ix->o=malloc(wb*sizeof(long));
+	size_t cs=0; /* where the current chromosome's windows begin */
+	for(;;) {
+		nw=mfnxtl(mf, ws, MXWPL);
+		g=(nw==-1)? -1 : cdid(cd, ws[0].s, ws[0].l);
+		if( (g != cg) || (nw==-1) ) { /* fill in the gaps of the one just finished. An empty file has none, and cg is still -1 */
+			for(i=m, o=-1;i>cs;--i) {
+				if(ix->o[i-1]==-1)
+					ix->o[i-1]=o;
+				o=ix->o[i-1];
+			}
+			if(nw==-1)
+				break;
+			if(g>=sb) {
+				sn=realloc(sn, (g+1)*sizeof(boole));
+				memset(sn+sb, 0, (g+1-sb)*sizeof(boole));
+				sb=g+1;
+			}
+			if(sn[g]) {
+				fprintf(stderr, "Error: the lines of chromosome %s are not all together in \"%s\", it needs sorting before it can be indexed.\n", cd->n[g], fname);
+				exit(EXIT_FAILURE);
+			}
+			sn[g]=1;
+			cg=g;
+			cs=m;
+			pst=0;
+		}
+		st=(nw>1)? sl2l(ws+1) : 0;
+		en=(nw>2)? sl2l(ws+2) : 0;
+		if(st < pst) {
+			fprintf(stderr, "Error: \"%s\" is not in start order within chromosome %s, it needs sorting before it can be indexed.\n", fname, cd->n[g]);
+			exit(EXIT_FAILURE);
+		}
+		pst=st;
+		o=ws[0].s - mf->d;
+		w0=st>>IXSH;
+		w1=((en>st)? en-1 : st)>>IXSH;
+		for(w=w0;w<=w1;++w) {
+			j=cs+w;
+			while(m <= j) { /* new windows */
+				ob=wb;
+				CONDREALLOC(m, wb, GBUF, ix->ci, int);
+				if(wb!=ob)
+					ix->o=realloc(ix->o, wb*sizeof(long));
+				ix->ci[m]=g;
+				ix->o[m++]=-1;
+			}
+			if(ix->o[j]==-1)
+				ix->o[j]=o;
+		}
+	}
+	mfclose(mf);
+	free(sn);
+	ix->m=m;
+	ix->b=wb;
+	macnt(MA_IDX, wb*(sizeof(int)+sizeof(long)));
+	ixgs(ix, cd);
+	return ix;
+}
+
+ix_t *ldix(char *fname, cd_t *cd) /* the index of fname, from its .bti sidecar if that's up to date, otherwise built and written out for next time */
+{
+	ix_t *ix;
+	char *d=btkmap(fname, BK_IDX);
+	if(!d) {
+		ix=bldix(fname, cd);
+		void *cs[1]={ix->o};
+		size_t csz[1]={ix->m*sizeof(long)};
+		btkwrite(fname, BK_IDX, ix->m, 0, cd, ix->ci, 1, cs, csz);
+		return ix;
+	}
+	bh_t *h=(bh_t*)d;
+	ix=calloc(1, sizeof(ix_t));
+	ix->mp=d;
+	ix->mpsz=h->sz;
+	ix->m=h->m;
+	ix->ci=btkids(d, cd, &ix->mci);
+	ix->o=(long*)(d+h->o[2]);
+	ixgs(ix, cd);
+	return ix;
+}
+
+void free_ix(ix_t *ix)
+{
+	mafree(MA_IDX, ix->b*(sizeof(int)+sizeof(long)) + (ix->ng+1)*sizeof(size_t));
+	if(!ix->mci)
+		free(ix->ci);
+	if(ix->mp)
+		munmap(ix->mp, ix->mpsz);
+	else
+		free(ix->o);
+	free(ix->gs);
+	free(ix);
+}
+
+void qreg(ob_t *ob, mf_t *mf, ix_t *ix, cd_t *cd, int g, long s, long e) /* print the lines of chromosome g which overlap [s,e) */
+{
+	/* straight to the offset of the window s is in, and on from there until the lines start at or after e */
+	sl_t w[MXWPL];
+	int nw;
+	size_t l;
+	long w0=s>>IXSH;
+	if( (g>=ix->ng) || (w0 >= (long)ixnw(ix, g)) )
+		return;
+	mf->p=mf->d+ix->o[ix->gs[g]+(w0<0? 0 : w0)];
+	while( (nw=mfnxtl(mf, w, MXWPL)) != -1) {
+		if( (w[0].l!=cd->nsz[g]-1) || memcmp(w[0].s, cd->n[g], w[0].l) || ((nw>1) && (sl2l(w+1) >= e)) )
+			break;
+		if( (nw>2) && (sl2l(w+2) <= s) )
+			continue;
+		l=(mf->p > mf->e)? (size_t)(mf->e - w[0].s) : (size_t)(mf->p-1 - w[0].s); /* the line as it is, however many words it has */
+		while( (l) && (w[0].s[l-1]=='\r') )
+			l--;
+		obs(ob, w[0].s, l);
+		obc(ob, '\n');
+	}
+	return;
+}
+
+void rqry(char *fname, char *qstr, cd_t *cd) /* region query: qstr is chr:start-end (or just chr) or a bed file of regions */
+{
+	struct stat sb;
+	sl_t w[MXWPL];
+	int nw;
+	long s, e;
+	size_t nq=0;
+	char *c;
+	ix_t *ix=ldix(fname, cd);
+	mf_t *mf=mfopen(fname);
+	ob_t *ob=create_ob(STDOUT_FILENO);
+	if( (!stat(qstr, &sb)) && (S_ISREG(sb.st_mode)) ) {
+		mf_t *qf=mfopen(qstr);
+		while( (nw=mfnxtl(qf, w, MXWPL)) != -1) {
+			nq++;
+			s=(nw>1)? sl2l(w+1) : 0;
+			e=(nw>2)? sl2l(w+2) : LONG_MAX;
+			if( (s<0) || (s>=e) ) {
+				free_ob(ob);
+				fprintf(stderr, "Error: region %zu of \"%s\" is empty, its start has to be 0 or more and under its end.\n", nq, qstr);
+				exit(EXIT_FAILURE);
+			}
+			qreg(ob, mf, ix, cd, cdid(cd, w[0].s, w[0].l), s, e);
+		}
+		mfclose(qf);
+	} else {
+		c=strrchr(qstr, ':');
+		s=0;
+		e=LONG_MAX;
+		if( (c) && (sscanf(c+1, "%li-%li", &s, &e) != 2) ) {
+			free_ob(ob);
+			fprintf(stderr, "Error: region \"%s\" should be chr:start-end, or a file of them.\n", qstr);
+			exit(EXIT_FAILURE);
+		}
+		if( (s<0) || (s>=e) ) {
+			free_ob(ob);
+			fprintf(stderr, "Error: region \"%s\" is empty, its start has to be 0 or more and under its end.\n", qstr);
+			exit(EXIT_FAILURE);
+		}
+		qreg(ob, mf, ix, cd, cdid(cd, qstr, (c)? (size_t)(c-qstr) : strlen(qstr)), s, e);
+	}
+	free_ob(ob);
+	mfclose(mf);
+	free_ix(ix);
+	return;
+}
+
+rmf_t *processrmf(char *fname, size_t *m, int *n, cd_t *cd, ar_t *ar) /*fourth column is string, other columns to be ignored */
+{
+	/* In order to make no assumptions, the file is treated as lines containing the same amount of words each,
+	 * except for lines starting with #, which are ignored (i.e. comments). Words arrive as slices of the mapped file:
+	 * the coordinates and strand are taken straight from the slice, the motif is copied out into the file's arena */
+
+	/* declarations */
+	mf_t *mf=mfopen(fname);
+	sl_t w[MXWPL];
+	int nw, k=-1;
+	size_t numl=0, lbuf=GBUF;
+	rmf_t *rmf=calloc(lbuf, sizeof(rmf_t));
+
+	while( (nw=mfnxtl(mf, w, MXWPL)) != -1) {
+		CONDREALLOC(numl, lbuf, GBUF, rmf, rmf_t);
+		rmf[numl].ci=cdid(cd, w[0].s, w[0].l);
+		if(nw>3) /* fourth col */
+			rmf[numl].c[0]=sl2l(w+3)-1L; // change to zero indexing
+		if(nw>4)
+			rmf[numl].c[1]=sl2l(w+4); // no 0 indexing change required here.
+		if(nw>6) /* the strand */
+			rmf[numl].sd=w[6].s[0];
+		if(nw>9) // the motif string
+			rmf[numl].m=sl2s(w+9, &rmf[numl].msz, ar);
+		chkncols(&k, nw);
+		numl++;
+	}
+	mfclose(mf);
+
+	/* normalization stage */
+	rmf = realloc(rmf, numl*sizeof(rmf_t)); /* normalize */
+	macnt(MA_ROWS, numl*sizeof(rmf_t));
+	*m= numl;
+	*n= (k==-1)? 0 : k; 
+
+	return rmf;
+}
+
+dpf_t *processdpf(char *fname, size_t *m, int *n, cd_t *cd, int nt) /*fourth column is string, other columns to be ignored */
+{
+	/* In order to make no assumptions, the file is treated as lines containing the same amount of words each,
+	 * except for lines starting with #, which are ignored (i.e. comments). Words arrive as slices of the mapped file:
+	 * position and depth are converted straight from the slice, nothing is copied out. Runs of the same depth become one row, see pldpf().
+	 * Big files are parsed in nt chunks at once, see pfparse() */
+	pf_t *pf=pfparse(fname, sizeof(dpf_t), pldpf, "", n, cd, NULL, nt);
+	return (dpf_t*)pfrows(pf, m);
+}
+
+gf_t *processgf(char *fname, size_t *m, int *n, cd_t *cd) /* read in a genome file */
+{
+	/* In order to make no assumptions, the file is treated as lines containing the same amount of words each,
+	 * except for lines starting with #, which are ignored (i.e. comments). Words arrive as slices of the mapped file:
+	 * the size is converted straight from the slice, nothing is copied out */
+
+	/* declarations */
+	mf_t *mf=mfopen(fname);
+	sl_t w[MXWPL];
+	int nw, k=-1;
+	size_t numl=0, lbuf=GBUF;
+	gf_t *gf=calloc(lbuf, sizeof(gf_t));
+
+	while( (nw=mfnxtl(mf, w, MXWPL)) != -1) {
+		CONDREALLOC(numl, lbuf, GBUF, gf, gf_t);
+		gf[numl].ci=cdid(cd, w[0].s, w[0].l);
+		if(nw>1)
+			gf[numl].z=sl2l(w+1);
+		chkncols(&k, nw);
+		numl++;
+	}
+	mfclose(mf);
+
+	/* normalization stage */
+	gf = realloc(gf, numl*sizeof(gf_t)); /* normalize */
+	macnt(MA_ROWS, numl*sizeof(gf_t));
+	*m= numl;
+	*n= (k==-1)? 0 : k; 
+
+	return gf;
+}
+
+void prtbd2ia(bgr_t2 *bed2, int n, ia_t *ia, cd_t *cd)
+{
+	size_t i;
+	int j;
+	ob_t *ob=create_ob(STDOUT_FILENO);
+	for(i=0;i<ia->z;++i) {
+		for(j=0;j<n;++j) {
+			if(j==0)
+				obstr(ob, cd->n[bed2[ia->a[i]].ci]);
+			else if(j==3)
+				obstr(ob, bed2[ia->a[i]].f);
+			else
+				obl(ob, bed2[ia->a[i]].c[j-1]);
+			obc(ob, ' ');
+		}
+		obc(ob, '\n');
+	}
+	free_ob(ob);
+	return;
+}
+
+void prtrmf(char *fname, rmf_t *rmf, size_t m6, cd_t *cd)
+{
+	size_t i;
+	ob_t *ob=create_ob(STDOUT_FILENO);
+	for(i=0;i<m6;++i) { // note how we cut out the spurious parts of the motif string to leave it pure and raw (slightly weird why two-char deletion is necessary.
+		obstr(ob, cd->n[rmf[i].ci]);
+		obc(ob, '\t');
+		obl(ob, rmf[i].c[0]);
+		obc(ob, '\t');
+		obl(ob, rmf[i].c[1]);
+		obc(ob, '\t');
+		obc(ob, rmf[i].sd);
+		obc(ob, '\t');
+		if(rmf[i].msz > 9)
+			obs(ob, rmf[i].m+7, rmf[i].msz-9);
+		obc(ob, '\n');
+	}
+	free_ob(ob);
+
+	printf("You just seen the %zu entries of repeatmasker gff2 file called \"%s\".\n", m6, fname); 
+	return;
+}
+
+void bed2in2(char *bed2fn, bgr_t2 *bed2, size_t m, int n, ia_t *ia, cd_t *cd) // split into 2 files
+{
+	size_t i, k=0;
+	int j;
+	size_t lfn=strlen(bed2fn);
+	char *outfn1=calloc(8+lfn ,sizeof(char));
+	char *outfn2=calloc(8+lfn, sizeof(char));
 	int rootsz=(int)(strchr(bed2fn, '.')-bed2fn);
 	sprintf(outfn1, "%.*s_p1.bed", rootsz, bed2fn);
 	sprintf(outfn2, "%.*s_p2.bed", rootsz, bed2fn);
-	FILE *of1=fopen(outfn1, "w");
-	FILE *of2=fopen(outfn2, "w");
-	printf("bgr_t is %i rows by %i columns and is as follows:\n", m, n); 
+	int fd1=open(outfn1, O_WRONLY|O_CREAT|O_TRUNC, 0644);
+	int fd2=open(outfn2, O_WRONLY|O_CREAT|O_TRUNC, 0644);
+	if( (fd1==-1) | (fd2==-1) ) {
+		fprintf(stderr, "Error: cannot open %s and %s for writing.\n", outfn1, outfn2);
+		exit(EXIT_FAILURE);
+	}
+	ob_t *of1=create_ob(fd1), *of2=create_ob(fd2), *of;
+	printf("bgr_t is %zu rows by %i columns and is as follows:\n", m, n); 
 	for(i=0;i<m;++i) {
-		if(i==ia->a[k]){
-			for(j=0;j<n;++j) {
-				if(j==0)
-					fprintf(of2, "%s\t", bed2[i].n);
-				else if(j==3)
-					fprintf(of2, "%s\n", bed2[i].f);
-				else
-					fprintf(of2, "%li\t", bed2[i].c[j-1]);
-			}
+		if( (k<ia->z) && (i==ia->a[k]) ) {
+			of=of2;
 			k++;
-		} else {
+		} else
+			of=of1;
+		for(j=0;j<n;++j) {
+			if(j==0)
+				obstr(of, cd->n[bed2[i].ci]);
+			else if(j==3)
+				obstr(of, bed2[i].f);
+			else
+				obl(of, bed2[i].c[j-1]);
+			obc(of, (j==3)? '\n' : '\t');
+		}
+	}
+	free_ob(of1);
+	free_ob(of2);
+	if( (close(fd1)) | (close(fd2)) ) {
+		fprintf(stderr, "Error: cannot write %s and %s.\n", outfn1, outfn2);
+		exit(EXIT_FAILURE);
+	}
+	free(outfn1);
+	free(outfn2);
+	return;
+}
+
+void mnmxco(float *co, size_t m, float *mnco, float *mxco) /* lowest and highest signal value, leaving mnco and mxco alone if none beat them */
+{
+	size_t i=0;
+	float mn=*mnco, mx=*mxco;
+#ifdef __SSE2__
+	/* 8 at a time in two pairs of vector registers. The new values go first in min/max so NaNs get skipped, as they are below */
+	__m128 vmn0=_mm_set1_ps(mn), vmn1=vmn0, vmx0=_mm_set1_ps(mx), vmx1=vmx0, x0, x1;
+	float t[4];
+	int k;
+	for(;i+8<=m;i+=8) {
+		x0=_mm_loadu_ps(co+i);
+		x1=_mm_loadu_ps(co+i+4);
+		vmn0=_mm_min_ps(x0, vmn0);
+		vmn1=_mm_min_ps(x1, vmn1);
+		vmx0=_mm_max_ps(x0, vmx0);
+		vmx1=_mm_max_ps(x1, vmx1);
+	}
+	_mm_storeu_ps(t, _mm_min_ps(vmn0, vmn1));
+	for(k=0;k<4;++k)
+		if(t[k] < mn)
+			mn=t[k];
+	_mm_storeu_ps(t, _mm_max_ps(vmx0, vmx1));
+	for(k=0;k<4;++k)
+		if(t[k] > mx)
+			mx=t[k];
+#endif
+	for(;i<m;++i) {
+		if(co[i] > mx)
+			mx=co[i];
+		if(co[i] < mn)
+			mn=co[i];
+	}
+	*mnco=mn;
+	*mxco=mx;
+	return;
+}
+
+size_t cogeidx(float *co, size_t m, float minsig, size_t *ix) /* put the indices of signal values at or over minsig in ix, return how many */
+{
+	size_t i=0, z=0;
+#ifdef __SSE2__
+	__m128 vt=_mm_set1_ps(minsig);
+	int msk;
+	for(;i+4<=m;i+=4) {
+		msk=_mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(co+i), vt));
+		while(msk) {
+			ix[z++]=i+__builtin_ctz(msk);
+			msk &= msk-1;
+		}
+	}
+#endif
+	for(;i<m;++i)
+		if(co[i] >= minsig)
+			ix[z++]=i;
+	return z;
+}
+
+void prtobed(bgc_t *bgrow, int n, float minsig, cd_t *cd) // print over bed ... a value that is over a certain signal
+{
+	size_t i0, i, k, z;
+	size_t ix[GBUF*GBUF]; /* the signal column is filtered a block at a time */
+	int j;
+	printf("bgr_t is %zu rows by %i columns and is as follows:\n", bgrow->m, n); 
+	ob_t *ob=create_ob(STDOUT_FILENO);
+	for(i0=0;i0<bgrow->m;i0+=GBUF*GBUF) {
+		z=cogeidx(bgrow->co+i0, (bgrow->m-i0<GBUF*GBUF)? bgrow->m-i0 : GBUF*GBUF, minsig, ix);
+		for(k=0;k<z;++k) {
+			i=i0+ix[k];
 			for(j=0;j<n;++j) {
 				if(j==0)
-					fprintf(of1, "%s\t", bed2[i].n);
+					obstr(ob, cd->n[bgrow->ci[i]]);
 				else if(j==3)
-					fprintf(of1, "%s\n", bed2[i].f);
+					obf(ob, bgrow->co[i], 6);
 				else
-					fprintf(of1, "%li\t", bed2[i].c[j-1]);
+					obl(ob, (j==1)? bgrow->st[i] : bgrow->en[i]);
+				obc(ob, ' ');
 			}
+			obc(ob, '\n');
 		}
 	}
-	fclose(of1);
-	fclose(of2);
-	free(outfn1);
-	free(outfn2);
+	free_ob(ob);
+	return;
+}
+
+hg_t *create_hg(int nb, boole lg, float mnco, float mxco) /* mnco and mxco are only needed for linear buckets */
+{
+	int j;
+	hg_t *hg=calloc(1, sizeof(hg_t));
+	hg->lg=lg;
+	hg->nb=(lg)? LGBUCKETS : nb;
+	hg->b=calloc(hg->nb+1, sizeof(size_t));
+	if(!lg) { /* the limits are built up exactly as they always were, they decide which bucket a value goes in */
+		float step=(mxco-mnco)/(float)nb;
+		hg->lim=malloc((nb-1)*sizeof(float));
+		hg->lim[0]=step+mnco;
+		for(j=1;j<nb-1;++j) 
+			hg->lim[j]=hg->lim[j-1]+step;
+		hg->mn=mnco;
+		hg->rstep=1./step;
+	}
+	return hg;
+}
+
+void free_hg(hg_t *hg)
+{
+	free(hg->b);
+	free(hg->lim);
+	free(hg);
+}
+
+void hglnidx(hg_t *hg, float *co, size_t z, int *bx) /* linear bucket indices for z values */
+{
+	/* the index is worked out arithmetically, 4 at a time, and then checked against the limits in case rounding put it one out */
+	size_t k=0;
+	int j, nb=hg->nb;
+#ifdef __SSE2__
+	__m128 vmn=_mm_set1_ps(hg->mn), vrs=_mm_set1_ps(hg->rstep), vz=_mm_setzero_ps(), vtop=_mm_set1_ps((float)(nb-1));
+	for(;k+4<=z;k+=4) /* max() first so NaN turns into 0 (it gets caught below) */
+		_mm_storeu_si128((__m128i*)(bx+k), _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(co+k), vmn), vrs), vz), vtop)));
+#endif
+	for(;k<z;++k) {
+		float x=(co[k]-hg->mn)*hg->rstep;
+		bx[k]=(x>0)? ((x<nb-1)? (int)x : nb-1) : 0;
+	}
+	for(k=0;k<z;++k) {
+		if(co[k] != co[k]) {
+			bx[k]=nb;
+			continue;
+		}
+		j=bx[k];
+		while( (j>0) && (co[k] < hg->lim[j-1]) )
+			j--;
+		while( (j<nb-1) && (co[k] >= hg->lim[j]) )
+			j++;
+		bx[k]=j;
+	}
+	return;
+}
+
+void hglgidx(float *co, size_t z, int *bx) /* log2 bucket indices for z values: straight out of the float's exponent bits */
+{
+	size_t k=0;
+	unsigned u;
+#ifdef __SSE2__
+	__m128 x, vz=_mm_setzero_ps();
+	__m128i vnan=_mm_set1_epi32(LGBUCKETS);
+	for(;k+4<=z;k+=4) {
+		x=_mm_loadu_ps(co+k);
+		_mm_storeu_si128((__m128i*)(bx+k), _mm_or_si128(_mm_and_si128(_mm_srli_epi32(_mm_castps_si128(x), 23), _mm_castps_si128(_mm_cmpgt_ps(x, vz))), _mm_and_si128(vnan, _mm_castps_si128(_mm_cmpunord_ps(x, x)))));
+	}
+#endif
+	for(;k<z;++k) {
+		memcpy(&u, co+k, sizeof(float));
+		bx[k]=(co[k] != co[k])? LGBUCKETS : (co[k]>0)? (int)(u>>23) : 0;
+	}
+	return;
+}
+
+void hgadd(hg_t *hg, float *co, size_t m) /* count m values into the histogram */
+{
+	size_t i, k, z;
+	int bx[HGBLK];
+	for(i=0;i<m;i+=z) {
+		z=(m-i<HGBLK)? m-i : HGBLK;
+		if(hg->lg)
+			hglgidx(co+i, z, bx);
+		else
+			hglnidx(hg, co+i, z, bx);
+		for(k=0;k<z;++k)
+			hg->b[bx[k]]++;
+	}
+	hg->m += m;
+	return;
+}
+
+void prthg(char *histname, hg_t *hg, float mxco, float mnco)
+{
+	int i, j0, j1;
+	if(!hg->lg) {
+		printf("%s value %d-bin hstgrm for: %-24.24s (totels=%04zu):\n", histname, hg->nb, histname, hg->m); 
+		printf("minval=%4.6f<-", mnco); 
+		for(i=0;i<hg->nb;++i) 
+			printf("| %zu ", hg->b[i]);
+		printf("|->maxval=%4.6f\n", mxco); 
+		return;
+	}
+	/* only the span of powers of 2 which have something in them */
+	for(j0=1;(j0<hg->nb) && (!hg->b[j0]);++j0)
+		;
+	for(j1=hg->nb-1;(j1>=j0) && (!hg->b[j1]);--j1)
+		;
+	printf("%s value log2 hstgrm for: %-24.24s (totels=%04zu):\n", histname, histname, hg->m); 
+	printf("minval=%4.6f<-", mnco); 
+	if(hg->b[0])
+		printf("| <=0: %zu ", hg->b[0]);
+	for(i=j0;i<=j1;++i)
+		printf("| 2^%i: %zu ", i-127, hg->b[i]);
+	printf("|->maxval=%4.6f\n", mxco); 
+	return;
+}
+
+void prtdets(bgc_t *bgrow, int n, char *label, int nbk, boole lg)
+{
+	size_t i, z;
+	float mxco=.0, mnco=10e20;
+	hg_t *hg;
+	printf("bgr_t is %zu rows by %i columns and is as follows:\n", bgrow->m, n); 
+	if(lg) { /* buckets don't depend on the range, so one pass does it */
+		hg=create_hg(nbk, lg, 0, 0);
+		for(i=0;i<bgrow->m;i+=z) {
+			z=(bgrow->m-i<HGBLK)? bgrow->m-i : HGBLK;
+			mnmxco(bgrow->co+i, z, &mnco, &mxco);
+			hgadd(hg, bgrow->co+i, z);
+		}
+	} else {
+		mnmxco(bgrow->co, bgrow->m, &mnco, &mxco);
+		hg=create_hg(nbk, lg, mnco, mxco);
+		hgadd(hg, bgrow->co, bgrow->m);
+	}
+	prthg(label, hg, mxco, mnco);
+	free_hg(hg);
+	return;
+}
+
+void prtdetg(char *fname, gf_t *gf, size_t m, int n, char *label, cd_t *cd)
+{
+	size_t i;
+	printf("%s called \"%s\" is %zu rows by %i columns and is as follows:\n", label, fname, m, n); 
+	ob_t *ob=create_ob(STDOUT_FILENO);
+	for(i=0;i<m;++i) {
+		obstr(ob, cd->n[gf[i].ci]);
+		obc(ob, '\t');
+		obl(ob, gf[i].z);
+		obc(ob, '\n');
+	}
+	free_ob(ob);
+
+	return;
+}
+
+void prtdeth(bgc_t *bgrow, int n, char *label) /* Print intensity bedgraph in histogram format */
+{
+	float mxco=.0, mnco=10e20;
+	printf("bgr_t is %zu rows by %i columns and is as follows:\n", bgrow->m, n); 
+	mnmxco(bgrow->co, bgrow->m, &mnco, &mxco);
+	hg_t *hg=create_hg(NUMBUCKETS, 0, mnco, mxco);
+	hgadd(hg, bgrow->co, bgrow->m);
+	prthg(label, hg, mxco, mnco);
+	free_hg(hg);
+	return;
+}
+
+size_t mfco(mf_t *mf, float *co, size_t z, size_t *m, int *k) /* read the signal of up to z more bedgraph rows, returns how many. */
+{
+	/* m counts the rows, k is for chkncols(), NULL if the file has already been checked */
+	sl_t w[MXWPL];
+	int nw;
+	size_t i=0;
+	while( (i<z) && ((nw=mfnxtl(mf, w, MXWPL)) != -1) ) {
+		if(nw >4) {
+			printf("Error, each row cannot exceed 4 words: revise your input file\n"); 
+			mfclose(mf);
+			exit(EXIT_FAILURE);
+		}
+		co[i++]=(nw>3)? sl2f(w+3) : 0;
+		if(k)
+			chkncols(k, nw);
+	}
+	*m += i;
+	return i;
+}
+
+void sprtdets(char *fname, char *label, int nbk, boole lg) /* prtdets() streaming the bedgraph rather than loading it */
+{
+	/* only a block of signal values is ever held. Log2 buckets get away with one pass, linear ones need the range first,
+	 * so they read the file twice */
+	float co[HGBLK];
+	float mxco=.0, mnco=10e20;
+	size_t z, m=0, m2=0;
+	int k=-1;
+	hg_t *hg=NULL;
+	mf_t *mf=mfopen(fname);
+	if(lg)
+		hg=create_hg(nbk, lg, 0, 0);
+	while( (z=mfco(mf, co, HGBLK, &m, &k)) ) {
+		mnmxco(co, z, &mnco, &mxco);
+		if(lg)
+			hgadd(hg, co, z);
+	}
+	mfclose(mf);
+	if(!lg) {
+		hg=create_hg(nbk, lg, mnco, mxco);
+		mf=mfopen(fname);
+		while( (z=mfco(mf, co, HGBLK, &m2, NULL)) )
+			hgadd(hg, co, z);
+		mfclose(mf);
+	}
+	printf("bgr_t is %zu rows by %i columns and is as follows:\n", m, (k==-1)? 0 : k); 
+	prthg(label, hg, mxco, mnco);
+	free_hg(hg);
+	return;
+}
+
+void prtbed2s(bgr_t2 *bed2, size_t m, int n, words_t *bedword, size_t m3, char *label, cd_t *cd)
+{
+	size_t i;
+	int j;
+	ws_t *ws=create_ws(bedword, m3);
+	printf("Separated feature file %s is %zu rows by %i columns and is as follows:\n", label, m, n); 
+	ob_t *ob=create_ob(STDOUT_FILENO);
+	for(i=0;i<m;++i) {
+		if( (!bed2[i].f) || (!wsin(ws, bed2[i].f, bed2[i].fsz-1)) )
+			continue;
+		for(j=0;j<n;++j) {
+			if(j==0)
+				obstr(ob, cd->n[bed2[i].ci]);
+			else if(j==3)
+				obstr(ob, bed2[i].f);
+			else
+				obl(ob, bed2[i].c[j-1]);
+			obc(ob, ' ');
+		}
+		obc(ob, '\n');
+	}
+	free_ob(ob);
+	free_ws(ws);
+	return;
+}
+
+ia_t *gensplbdx(bgr_t2 *bed2, size_t m, words_t *bedword, size_t m3) /* generate split bed index */
+{
+	/* the indices of the features named in bedword, which go in a hash set first, so it's one lookup a feature */
+	size_t i;
+	ia_t *ia=calloc(1, sizeof(ia_t));
+	ia->b=GBUF;
+	ia->a=calloc(ia->b, sizeof(size_t));
+	ws_t *ws=create_ws(bedword, m3);
+	for(i=0;i<m;++i)
+		if( (bed2[i].f) && (wsin(ws, bed2[i].f, bed2[i].fsz-1)) ) {
+			CONDREALLOC(ia->z, ia->b, GBUF, ia->a, size_t);
+			ia->a[ia->z]=i;
+			ia->z++;
+		}
+	free_ws(ws);
+	ia->a=realloc(ia->a, ia->z*sizeof(size_t)); /*normalize */
+	return ia;
+}
+
+void prtbed2fo(char *fname, bgr_t2 *bgrow, size_t m, int n, char *label) /* print feature beds file features only */
+{
+	size_t i;
+	printf("%s file called %s is %zu rows by %i columns and has following features:\n", label, fname, m, n); 
+	printf("You can direct these name into a file and then presient to this program again under the -u option,\n");
+	printf("whereupon only those name will be looked at\n");
+	ob_t *ob=create_ob(STDOUT_FILENO);
+	for(i=0;i<m;++i) {
+		obstr(ob, bgrow[i].f);
+		obc(ob, '\n');
+	}
+	free_ob(ob);
+
+	return;
+}
+
+void prtmr(ob_t *ob, mr_t *r, int agg, cd_t *cd) /* print a merged run */
+{
+	float v;
+	switch(agg) {
+		case AG_MAX:
+			v=r->mx;
+			break;
+		case AG_MEAN:
+			v=(r->nb)? r->sm/r->nb : r->mn;
+			break;
+		case AG_SUM:
+			v=r->sm;
+			break;
+		default:
+			v=r->mn;
+	}
+	obstr(ob, cd->n[r->g]);
+	obc(ob, '\t');
+	obl(ob, r->s);
+	obc(ob, '\t');
+	obl(ob, r->e);
+	obc(ob, '\t');
+	obf(ob, v, 6);
+	obc(ob, '\n');
 	return;
 }
 
-void prtobed(bgr_t *bgrow, int m, int n, float minsig) // print over bed ... a value that is over a certain signal
+int cmpfk(const void *a, const void *b) /* qsort comparison for feature keys */
 {
-	int i, j;
-	printf("bgr_t is %i rows by %i columns and is as follows:\n", m, n); 
-	for(i=0;i<m;++i) {
-		if(bgrow[i].co >= minsig) {
-			for(j=0;j<n;++j) {
-				if(j==0)
-					printf("%s ", bgrow[i].n);
-				else if(j==3)
-					printf("%2.6f ", bgrow[i].co);
-				else
-					printf("%li ", bgrow[i].c[j-1]);
-			}
-			printf("\n"); 
-		}
+	const fk_t *x=a, *y=b;
+	if(x->g != y->g)
+		return (x->g > y->g) - (x->g < y->g);
+	if(x->s != y->s)
+		return (x->s > y->s) - (x->s < y->s);
+	return (x->i > y->i) - (x->i < y->i);
+}
+
+fs_t *create_fs(bgr_t2 *bed2, size_t m2, cd_t *cd) /* set up the features for a sweep */
+{
+	size_t j;
+	int g;
+	fs_t *fs=calloc(1, sizeof(fs_t));
+	fs->ng=cd->z;
+	fs->m=m2;
+	fs->fk=malloc(m2*sizeof(fk_t));
+	for(j=0;j<m2;++j) {
+		fs->fk[j].g=bed2[j].ci;
+		fs->fk[j].s=bed2[j].c[0];
+		fs->fk[j].e=bed2[j].c[1];
+		fs->fk[j].i=j;
 	}
+	qsort(fs->fk, m2, sizeof(fk_t), cmpfk);
+	fs->gs=calloc(fs->ng+1, sizeof(size_t));
+	for(j=0;j<m2;++j)
+		fs->gs[fs->fk[j].g+1]++;
+	for(g=0;g<fs->ng;++g)
+		fs->gs[g+1]+=fs->gs[g];
+	fs->act=malloc(m2*sizeof(size_t));
+	fs->nc=calloc(fs->ng+1, sizeof(size_t));
+	macnt(MA_IDX, m2*(sizeof(fk_t)+sizeof(size_t)) + (fs->ng+1)*2*sizeof(size_t));
+	return fs;
+}
+
+void fschrom(fs_t *fs, int g) /* the stream has moved on to chromosome id g: its features are next to be opened */
+{
+	fs->nxt=(g<fs->ng)? fs->gs[g] : 0;
+	fs->lst=(g<fs->ng)? fs->gs[g+1] : 0;
+	fs->na=0;
 	return;
 }
 
-int *hist_co(bgr_t *bgrow, int m, float mxco, float mnco, int numbuckets)
+void fsopen(fs_t *fs, long s) /* open all the current chromosome's features which start at or before s */
 {
-	int i, j;
-	float step=(mxco-mnco)/(float)numbuckets;
-	float *bucketlimarr=malloc((numbuckets-1)*sizeof(float));
-	int *bucketarr=calloc(numbuckets, sizeof(int));
-	bucketlimarr[0]=step+mnco;
-	for(i=1;i<numbuckets-1;++i) 
-		bucketlimarr[i]=bucketlimarr[i-1]+step;
+	while( (fs->nxt < fs->lst) && (fs->fk[fs->nxt].s <= s) )
+		fs->act[fs->na++]=fs->fk[fs->nxt++].i;
+	return;
+}
 
-	for(i=0;i<m;++i)
-		if(bgrow[i].co>=bucketlimarr[numbuckets-2]) {
-			bucketarr[numbuckets-1]++;
-			continue;
-		} else {
-			for(j=0;j<numbuckets-1;++j)
-				if(bgrow[i].co < bucketlimarr[j]) {
-					bucketarr[j]++;
-					break;
-				}
+void free_fs(fs_t *fs)
+{
+	int g;
+	for(g=0;g<=fs->ng;++g)
+		stats.cmps += fs->nc[g];
+	mafree(MA_IDX, fs->m*(sizeof(fk_t)+sizeof(size_t)) + (fs->ng+1)*2*sizeof(size_t) + ((fs->lv)? (fs->ng+1)*sizeof(int) : 0));
+	free(fs->nc);
+	free(fs->fk);
+	free(fs->gs);
+	free(fs->act);
+	free(fs->lv);
+	free(fs);
+}
+
+int fsidx1(fk_t *a, size_t n) /* make n sorted keys into an implicit interval tree, returning the level of its root */
+{
+	/* The keys stay in start order and the tree lives in the order itself, as in cgranges: keys at even positions are leaves,
+	 * those at level k have k trailing 1 bits in their position, and the children of position x at level k are x-2^(k-1) and
+	 * x+2^(k-1). Each key's mx gets the highest end under it. Positions past the end still have to be accounted for, which is
+	 * what last/lasti are for: the highest end under the rightmost real key of each level */
+	size_t i, i0, x, st, lasti=0;
+	long last=0, el, er, e;
+	int k;
+	if(!n)
+		return -1;
+	for(i=0;i<n;i+=2) {
+		lasti=i;
+		last=a[i].mx=a[i].e;
+	}
+	for(k=1;((size_t)1<<k)<=n;++k) {
+		x=(size_t)1<<(k-1);
+		i0=(x<<1)-1;
+		st=x<<2;
+		for(i=i0;i<n;i+=st) {
+			el=a[i-x].mx;
+			er=(i+x<n)? a[i+x].mx : last;
+			e=a[i].e;
+			e=(e>el)? e : el;
+			e=(e>er)? e : er;
+			a[i].mx=e;
 		}
-	free(bucketlimarr);
-	return bucketarr;
+		lasti=((lasti>>k)&1)? lasti-x : lasti+x;
+		if( (lasti<n) && (a[lasti].mx>last) )
+			last=a[lasti].mx;
+	}
+	return k-1;
 }
 
-void prthist(char *histname, int *bucketarr, int numbuckets, int m, float mxco, float mnco)
+void fsidx(fs_t *fs) /* set up the features for lookups as well, an interval tree for each chromosome */
 {
-	int i;
-	printf("%s value %d-bin hstgrm for: %-24.24s (totels=%04i):\n", histname, numbuckets, histname, m); 
-	printf("minval=%4.6f<-", mnco); 
-	for(i=0;i<numbuckets;++i) 
-		printf("| %i ", bucketarr[i]);
-	printf("|->maxval=%4.6f\n", mxco); 
+	int g;
+	fs->lv=malloc((fs->ng+1)*sizeof(int));
+	macnt(MA_IDX, (fs->ng+1)*sizeof(int));
+	for(g=0;g<fs->ng;++g)
+		fs->lv[g]=fsidx1(fs->fk+fs->gs[g], fs->gs[g+1]-fs->gs[g]);
 	return;
 }
 
-void prtdets(bgr_t *bgrow, int m, int n, char *label)
+size_t fswthn(fs_t *fs, int g, long s, long e, size_t *b) /* put the indices of chromosome g's features which [s,e) lies within in b, return how many */
 {
-	int i;
-	float mxco=.0, mnco=10e20;
-	printf("bgr_t is %i rows by %i columns and is as follows:\n", m, n); 
-	for(i=0;i<m;++i) {
-		if(bgrow[i].co > mxco)
-			mxco=bgrow[i].co;
-		if(bgrow[i].co < mnco)
-			mnco = bgrow[i].co;
-	}
-	int *hco=hist_co(bgrow, m, mxco, mnco, NUMBUCKETS);
-	prthist(label, hco, NUMBUCKETS, m, mxco, mnco);
-	free(hco);
+	/* a walk down the tree, leaving out subtrees whose highest end is short of e, and anything starting after s.
+	 * Small subtrees are just scanned. O(log n + the number found) */
+	struct { size_t x; int k; boole w; } stk[64], z; /* w: left child done */
+	size_t n, i, i0, i1, y, nb=0, nc=0;
+	int t=0;
+	fk_t *a;
+	if( (g<0) || (g>=fs->ng) || (fs->lv[g]<0) )
+		return 0;
+	a=fs->fk+fs->gs[g];
+	n=fs->gs[g+1]-fs->gs[g];
+	stk[t].k=fs->lv[g];
+	stk[t].x=((size_t)1<<stk[t].k)-1;
+	stk[t++].w=0;
+	while(t) {
+		z=stk[--t];
+		if(z.k<=3) {
+			i0=z.x>>z.k<<z.k;
+			i1=i0+((size_t)1<<(z.k+1))-1;
+			if(i1>n)
+				i1=n;
+			for(i=i0;(i<i1) && (a[i].s<=s);++i)
+				if(a[i].e>=e)
+					b[nb++]=a[i].i;
+			nc += i-i0;
+		} else if(!z.w) {
+			y=z.x-((size_t)1<<(z.k-1));
+			stk[t].k=z.k;
+			stk[t].x=z.x;
+			stk[t++].w=1;
+			if( (y>=n) || (a[y].mx>=e) ) {
+				stk[t].k=z.k-1;
+				stk[t].x=y;
+				stk[t++].w=0;
+			}
+		} else if( (z.x<n) && (a[z.x].s<=s) ) {
+			nc++;
+			if(a[z.x].e>=e)
+				b[nb++]=a[z.x].i;
+			stk[t].k=z.k-1;
+			stk[t].x=z.x+((size_t)1<<(z.k-1));
+			stk[t++].w=0;
+		}
+	}
+	fs->nc[g] += nc;
+	return nb;
+}
+
+jt_t *create_jt(size_t m2)
+{
+	jt_t *jt=malloc(sizeof(jt_t));
+	jt->reghits=calloc(m2, sizeof(long));
+	jt->cloci=calloc(m2, sizeof(long));
+	jt->assoctval=calloc(m2, sizeof(double));
+	jt->m=m2;
+	macnt(MA_JOIN, m2*(2*sizeof(long)+sizeof(double)));
+	return jt;
+}
+
+void prtjt(jt_t *jt, bgr_t2 *bed2, size_t m2) /* print the totals of a join */
+{
+	size_t j;
+	int k=stbeg("output");
+	ob_t *ob=create_ob(STDOUT_FILENO);
+	for(j=0;j<m2;++j) {
+		stats.hits += jt->reghits[j];
+		obstr(ob, "Bed2idx ");
+		obl(ob, j);
+		obstr(ob, " / name ");
+		obstr(ob, bed2[j].f);
+		obstr(ob, " / size ");
+		obl(ob, bed2[j].c[1]-bed2[j].c[0]);
+		obstr(ob, " got ");
+		obl(ob, jt->reghits[j]);
+		obstr(ob, " hits from bed1 , being ");
+		obl(ob, jt->cloci[j]);
+		obstr(ob, " loci and total assoc (prob .intensty) val ");
+		obf(ob, jt->assoctval[j], 2);
+		obc(ob, '\n');
+	}
+	free_ob(ob);
+	stend(k);
 	return;
 }
 
-void prtdetg(char *fname, gf_t *gf, int m, int n, char *label)
+void free_jt(jt_t *jt)
 {
-	int i;
-	printf("%s called \"%s\" is %i rows by %i columns and is as follows:\n", label, fname, m, n); 
-	for(i=0;i<m;++i)
-		printf("%s\t%li\n", gf[i].n, gf[i].z);
+	mafree(MA_JOIN, jt->m*(2*sizeof(long)+sizeof(double)));
+	free(jt->reghits);
+	free(jt->cloci);
+	free(jt->assoctval);
+	free(jt);
+}
 
+typedef struct /* mj_t: what the chromosomes of m2beds() need */
+{
+	bgc_t *bgrow;
+	fs_t *fs;
+	jt_t *jt;
+	size_t *ri, *rs; /* the rows grouped by chromosome, and where each chromosome's begin */
+} mj_t;
+
+void m2bedsg(void *v, int g) /* chromosome g of m2beds() */
+{
+	mj_t *a=v;
+	bgc_t *bgrow=a->bgrow;
+	size_t i, j, k, r, z;
+	long rangecov;
+	if( (a->rs[g]==a->rs[g+1]) || (a->fs->lv[g]<0) )
+		return;
+	size_t *b=malloc((a->fs->gs[g+1]-a->fs->gs[g])*sizeof(size_t)); /* features found for a row */
+	for(i=a->rs[g];i<a->rs[g+1];++i) {
+		r=a->ri[i];
+		z=fswthn(a->fs, g, bgrow->st[r], bgrow->en[r], b);
+		rangecov=bgrow->en[r] - bgrow->st[r]; // range covered by this hit
+		for(k=0;k<z;++k) {
+			j=b[k];
+			a->jt->reghits[j]++;
+			a->jt->cloci[j]+=rangecov;
+			a->jt->assoctval[j]+=rangecov * bgrow->co[r];
+		}
+	}
+	free(b);
 	return;
 }
 
-void prtdeth(bgr_t *bgrow, int m, int n, char *label) /* Print intensity bedgraph in histogram format */
+void m2beds(bgc_t *bgrow, bgr_t2 *bed2, size_t m2, cd_t *cd, int nt) /* match up 2 beds */
 {
-	int i;
-	float mxco=.0, mnco=10e20;
-	printf("bgr_t is %i rows by %i columns and is as follows:\n", m, n); 
-	for(i=0;i<m;++i) {
-		if(bgrow[i].co > mxco)
-			mxco=bgrow[i].co;
-		if(bgrow[i].co < mnco)
-			mnco = bgrow[i].co;
-	}
-	int *hco=hist_co(bgrow, m, mxco, mnco, NUMBUCKETS);
-	prthist(label, hco, NUMBUCKETS, m, mxco, mnco);
-	free(hco);
+	/* The features go into an interval tree per chromosome and each bedgraph row looks up the features it lies within,
+	 * so features can nest or overlap and neither file needs to be in any order. A feature only gets hits from its own chromosome,
+	 * so the chromosomes are shared out among nt threads. Each feature still adds up its rows in file order, so the output is the same */
+	mj_t a;
+	a.bgrow=bgrow;
+	a.fs=create_fs(bed2, m2, cd);
+	fsidx(a.fs);
+	a.jt=create_jt(m2);
+	a.ri=gpart(bgrow->ci, sizeof(int), bgrow->m, a.fs->ng, &a.rs);
+	pjrun(m2bedsg, &a, a.fs->ng, nt);
+	prtjt(a.jt, bed2, m2);
+	free_gpart(a.ri, a.rs, bgrow->m, a.fs->ng);
+	free_jt(a.jt);
+	free_fs(a.fs);
 	return;
 }
 
-void prtbed2s(bgr_t2 *bed2, int m, int n, words_t *bedword, int m3, int n3, char *label)
+void jrow(fs_t *fs, bgr_t2 *bed2, jt_t *jt, long s, long e, float co, boole wflg) /* one step of the sweep: add bedgraph row [s,e) to the open features it hits */
 {
-	/* TODO what you want is a copy of the data structure */
-	int i, j, k;
-	boole foundifeat;
-	printf("Separated feature file %s is %i rows by %i columns and is as follows:\n", label, m, n); 
-	for(i=0;i<m;++i) {
-		foundifeat=0;
-		for(k=0;k<m3;++k) {
-			if(!strcmp(bedword[k].n, bed2[i].f) ) {
-				foundifeat=1;
-				for(j=0;j<n;++j) {
-					if(j==0)
-						printf("%s ", bed2[i].n);
-					else if(j==3)
-						printf("%s ", bed2[i].f);
-					else
-						printf("%li ", bed2[i].c[j-1]);
-				}
-				printf("\n"); 
-			}
-			if(foundifeat)
-				break;
-		}
+	/* Without wflg the row has to lie within a feature. With it, a row hits every feature it overlaps, and only the overlap counts
+	 * towards cloci and assoctval. Features the rows have gone past are closed for good, so each row only sees the open ones */
+	size_t i, j, k;
+	long rangecov;
+	fsopen(fs, (wflg)? e-1 : s);
+	fs->nc[fs->ng] += fs->na;
+	for(i=0,k=0;i<fs->na;++i) {
+		j=fs->act[i];
+		if( (bed2[j].c[1] < s) || ((wflg) && (bed2[j].c[1] == s)) ) // this row and all later ones start after this feature is over.
+			continue;
+		fs->act[k++]=j;
+		if(wflg) {
+			rangecov=((e < bed2[j].c[1])? e : bed2[j].c[1]) - ((s > bed2[j].c[0])? s : bed2[j].c[0]); // range of this row inside the feature
+			if(rangecov<=0)
+				continue;
+		} else if(e <= bed2[j].c[1])
+			rangecov=e - s; // range covered by this hit
+		else
+			continue;
+		jt->reghits[j]++;
+		jt->cloci[j]+=rangecov;
+		jt->assoctval[j]+=rangecov * co;
 	}
+	fs->na=k;
 	return;
 }
 
-ia_t *gensplbdx(bgr_t2 *bed2, int m, int n, words_t *bedword, int m3, int n3) /* generate split bed index */
+void sw2beds(bgc_t *bgrow, bgr_t2 *bed2, size_t m2, cd_t *cd) /* match up 2 beds, counting the part of each row in each feature */
 {
-	/* TODO what you want is a copy of the data structure:
-	 * NOPE! what you want is an array of indices */
-	int i, k;
-	ia_t *ia=calloc(1, sizeof(ia_t));
-	ia->b=GBUF;
-	ia->a=calloc(ia->b, sizeof(int));
-	boole foundifeat;
+	/* One sweep along both, in start order chromosome by chromosome, clipping rows to the features they overlap (see jrow()).
+	 * The features are put in order by create_fs(), and the rows are too if they aren't already */
+	size_t i, r, m=bgrow->m;
+	int cg=-1;
+	fk_t *ro=NULL; /* the rows' order, if they have to be sorted */
+	fs_t *fs=create_fs(bed2, m2, cd);
+	jt_t *jt=create_jt(m2);
+	for(i=1;i<m;++i)
+		if( (bgrow->ci[i] < bgrow->ci[i-1]) || ((bgrow->ci[i] == bgrow->ci[i-1]) && (bgrow->st[i] < bgrow->st[i-1])) )
+			break;
+	if(i<m) {
+		ro=malloc(m*sizeof(fk_t));
+		for(i=0;i<m;++i) {
+			ro[i].g=bgrow->ci[i];
+			ro[i].s=bgrow->st[i];
+			ro[i].i=i;
+		}
+		qsort(ro, m, sizeof(fk_t), cmpfk);
+	}
 	for(i=0;i<m;++i) {
-		foundifeat=0;
-		for(k=0;k<m3;++k) {
-			if(!strcmp(bedword[k].n, bed2[i].f) ) {
-				foundifeat=1;
-				CONDREALLOC(ia->z, ia->b, GBUF, ia->a, int);
-				ia->a[ia->z]=i;
-				ia->z++;
-			}
-			if(foundifeat)
-				break;
+		r=(ro)? ro[i].i : i;
+		if(bgrow->ci[r] != cg) {
+			cg=bgrow->ci[r];
+			fschrom(fs, cg);
 		}
+		jrow(fs, bed2, jt, bgrow->st[r], bgrow->en[r], bgrow->co[r], 1);
 	}
-	ia->a=realloc(ia->a, ia->z*sizeof(int)); /*normalize */
-	return ia;
+	prtjt(jt, bed2, m2);
+	free(ro);
+	free_jt(jt);
+	free_fs(fs);
+	return;
 }
 
-void prtbed2fo(char *fname, bgr_t2 *bgrow, int m, int n, char *label) /* print feature beds file features only */
+void sm2beds(char *fname, bgr_t2 *bed2, size_t m2, cd_t *cd, boole wflg) /* match up 2 beds, streaming the bedgraph rather than loading it */
 {
-	int i;
-	printf("%s file called %s is %i rows by %i columns and has following features:\n", label, fname, m, n); 
-	printf("You can direct these name into a file and then presient to this program again under the -u option,\n");
-	printf("whereupon only those name will be looked at\n");
-	for(i=0;i<m;++i)
-		printf("%s\n", bgrow[i].f);
+	/* The bedgraph is never held in memory: its rows are read one at a time and checked against the features of their chromosome,
+	 * which are put in start order beforehand. Only the features whose start has been passed and whose end hasn't are checked,
+	 * so features can nest or overlap. Each chromosome's rows need to be together and in start order.
+	 * Memory goes with the number of features, not the size of the bedgraph. */
+	int nw;
+	fs_t *fs=create_fs(bed2, m2, cd);
+	jt_t *jt=create_jt(m2);
+	long c[2], pc0=0;
+	float co;
+	int g, cg=-1; /* cg: the chromosome the bedgraph is on */
+	sl_t w[MXWPL];
+	mf_t *mf=mfopen(fname);
+	while( (nw=mfnxtl(mf, w, MXWPL)) != -1) {
+		if(nw >4) {
+			printf("Error, each row cannot exceed 4 words: revise your input file\n"); 
+			mfclose(mf);
+			exit(EXIT_FAILURE);
+		}
+		c[0]=(nw>1)? sl2l(w+1) : 0;
+		c[1]=(nw>2)? sl2l(w+2) : 0;
+		co=(nw>3)? sl2f(w+3) : 0;
+		g=cdid(cd, w[0].s, w[0].l);
+		if(g != cg) { /* on to a new chromosome */
+			cg=g;
+			fschrom(fs, cg);
+		} else if(c[0] < pc0) {
+			printf("Error: bedgraph file \"%s\" is not in start order within chromosome %s, which streaming requires. Bailing out.\n", fname, cd->n[cg]); 
+			exit(EXIT_FAILURE);
+		}
+		pc0=c[0];
+		jrow(fs, bed2, jt, c[0], c[1], co, wflg);
+	}
+	mfclose(mf);
 
+	prtjt(jt, bed2, m2);
+	free_jt(jt);
+	free_fs(fs);
 	return;
 }
 
-void prtmbed(bgr_t **bgra, i4_t *dca, int dcasz, int n) /* the 2D version */
+typedef struct /* cf_t: a set of features for coverage */
 {
-	int i, j;
-	for(i=0;i<dcasz;++i) {
-		for(j=0;j<dca[i].sc;++j) { // we're cycling though all of them, though we're really only interested in the first and last.
-			if(j==0) { 
-				printf("%s ", bgra[i][j].n);
-				printf("%li ", bgra[i][j].c[0]);
-			}
-			if(j==dca[i].sc-1) { // note this cannot be an else if, because if only one line j = 0 = dca[i]-1.
-				printf("%li ", bgra[i][j].c[1]);
-				printf("%2.6f ", dca[i].mc);
-			}
-		}
-		printf("\n"); 
+	char *ft; /* the features, bgr_t2 or rmf_t */
+	size_t sz, co; /* size of a feature, and where its coordinates are in it */
+	size_t m; /* how many */
+	size_t *ri, *rs; /* the features grouped by chromosome, and where each chromosome's begin */
+} cf_t;
+
+typedef struct /* gj_t: what the lines of the genome file need in mgfcov() */
+{
+	gf_t *gf;
+	cf_t *cf; /* the feature sets */
+	int nf;
+	long *acov; /* coverage of each chromosome by the features */
+	boole *bad; /* a feature starts beyond the end of the chromosome */
+} gj_t;
+
+void bmset(unsigned long long *bm, long a, long b) /* set bits a to b-1 */
+{
+	size_t wa, wb, w;
+	unsigned long long ma, mb;
+	if(a>=b)
+		return;
+	wa=a>>6;
+	wb=(b-1)>>6;
+	ma=~0ULL<<(a&63);
+	mb=~0ULL>>(63-((b-1)&63));
+	if(wa==wb) {
+		bm[wa] |= ma&mb;
+		return;
 	}
+	bm[wa] |= ma;
+	for(w=wa+1;w<wb;++w)
+		bm[w]=~0ULL;
+	bm[wb] |= mb;
 	return;
 }
 
-void m2beds(bgr_t *bgrow, bgr_t2 *bed2, int m2, int m) /* match up 2 beds */
+void mgfcovj(void *v, int j) /* coverage of the chromosome on line j of the genome file */
 {
-	/* TODO: there could be an issue with intensity l;ines that span the end of one region and the start of another
-	 * Need to look into that. this will only introduce a small error though.
-	 */
-	int i, j;
-	int reghits; /* hits for region: number of lines in bed1 which coincide with a region in bed2 */
-	int cloci; /* as opposed to hit, catch the number of loci */
-	int rangecov=0;
-	double assoctval=0;
-	int istarthere=0, catchingi=0;
-	boole caught;
-	for(j=0;j<m2;++j) {
-		caught=0;
-		reghits=0;
-		cloci=0;
-		assoctval=0;
-		for(i=istarthere;i<m;++i) {
-			if( !(strcmp(bgrow[i].n, bed2[j].n)) & (bgrow[i].c[0] >= bed2[j].c[0]) & (bgrow[i].c[1] <= bed2[j].c[1]) ) {
-				reghits++;
-				rangecov=bgrow[i].c[1] - bgrow[i].c[0]; // range covered by this hit
-				cloci+=rangecov;
-				assoctval+=rangecov * bgrow[i].co;
-				catchingi=i;
-				caught=1;
-			} else if (caught) { // will catch first untruth after a series of truths.
-				caught=2;
-				break; // bed1 is ordered so we can forget about trying to match anymore.
+	/* a bit for each base of the chromosome, set by every feature on it from every set, then counted.
+	 * So overlapping features and repeats only count once */
+	gj_t *a=v;
+	size_t i, nw;
+	long *c, z=a->gf[j].z, cv=0;
+	int g=a->gf[j].ci, f;
+	cf_t *cf;
+	if(z<=0)
+		return;
+	nw=(z+63)>>6;
+	unsigned long long *bm=calloc(nw, sizeof(unsigned long long));
+	macnt(MA_JOIN, nw*sizeof(unsigned long long));
+	for(f=0;f<a->nf;++f) {
+		cf=a->cf+f;
+		for(i=cf->rs[g];i<cf->rs[g+1];++i) {
+			c=(long*)(cf->ft + cf->ri[i]*cf->sz + cf->co);
+			if( (z <= c[0]) & (z < c[1]) ) {
+				a->bad[j]=1;
+				continue;
 			}
+			bmset(bm, (c[0]>0)? c[0] : 0, (c[1]<z)? c[1] : z);
 		}
-		if(caught==2)
-			istarthere=catchingi+1;
-		printf("Bed2idx %i / name %s / size %li got %i hits from bed1 , being %i loci and total assoc (prob .intensty) val %4.2f\n", j, bed2[j].f, bed2[j].c[1]-bed2[j].c[0], reghits, cloci, assoctval);
-		if(istarthere >= m)
-			break;
 	}
+	for(i=0;i<nw;++i)
+		cv += __builtin_popcountll(bm[i]);
+	a->acov[j]=cv;
+	mafree(MA_JOIN, nw*sizeof(unsigned long long));
+	free(bm);
 	return;
 }
 
-void mgf2bed(char *gfname, char *ffile, gf_t *gf, bgr_t2 *bed2, int m2, int m5) /* match gf to feature bed file */
+void mgfcov(gf_t *gf, size_t m5, cf_t *cf, int nf, cd_t *cd, int nt) /* print the coverage of each chromosome in the genome file by the nf sets of features cf */
 {
+	/* The chromosomes are independent, so they're worked out on nt threads, then printed in genome file order */
 	setlocale(LC_NUMERIC, "");
-	int i, j;
-	int reghits; /* hits for region: number of lines in bed1 which coincide with a region in bed2 */
-	int *acov=calloc(m5, sizeof(int)); /* coverage of this chromosome in the bed file */
-	int rangecov=0;
-	int istarthere=0, catchingi=0;
-	int strmatch;
-	boole caught;
-	printf("Coverage of \"%s\" (genome size file) by \"%s\" (feature bed file):\n", gfname, ffile); 
+	size_t j;
+	int f;
+	gj_t a={gf, cf, nf, calloc(m5, sizeof(long)), calloc(m5, sizeof(boole))};
+	macnt(MA_JOIN, m5*(sizeof(long)+sizeof(boole)));
+	for(f=0;f<nf;++f)
+		cf[f].ri=gpart(cf[f].ft, cf[f].sz, cf[f].m, cd->z, &cf[f].rs);
+	pjrun(mgfcovj, &a, m5, nt);
+	for(j=0;j<m5;++j)
+		for(f=0;f<nf;++f)
+			stats.hits += cf[f].rs[gf[j].ci+1]-cf[f].rs[gf[j].ci];
 	for(j=0;j<m5;++j) {
-		caught=0;
-		reghits=0;
-		for(i=istarthere;i<m2;++i) {
-			strmatch=strcmp(gf[j].n, bed2[i].n);
-			if( (!strmatch) & (gf[j].z > bed2[i].c[0]) & (gf[j].z >= bed2[i].c[1]) ) {
-				reghits++;
-				rangecov=bed2[i].c[1] - bed2[i].c[0]; // range covered by this hit
-				acov[j] +=rangecov;
-				catchingi=i;
-				caught=1;
-			} else if (caught) { // will catch first untruth after a series of truths.
-				caught=2;
-				break; // bed1 is ordered so we can forget about trying to match anymore.
-			} else if( (!strmatch) & (gf[j].z <= bed2[i].c[0]) & (gf[j].z < bed2[i].c[1]) ) {
-				printf("There's a problem with the genome size file ... are you sure it's the right one? Bailing out.\n"); 
-				exit(EXIT_FAILURE);
-			}
+		if(a.bad[j]) {
+			printf("There's a problem with the genome size file ... are you sure it's the right one? Bailing out.\n"); 
+			exit(EXIT_FAILURE);
 		}
-		if(caught==2)
-			istarthere=catchingi+1;
-		// printf("%s / cov %2.4f got %i hits from bed2\n", gf[j].n, (float)acov[j]/gf[j].z, reghits);
-		printf("%s\t%4.2f%%\tof %'li bp\n", gf[j].n, 100.*(float)acov[j]/gf[j].z, gf[j].z);
-		if(istarthere >= m2)
-			break;
+		printf("%s\t%4.2f%%\tof %'li bp\n", cd->n[gf[j].ci], 100.*(float)a.acov[j]/gf[j].z, gf[j].z);
 	}
-	free(acov);
+	for(f=0;f<nf;++f)
+		free_gpart(cf[f].ri, cf[f].rs, cf[f].m, cd->z);
+	mafree(MA_JOIN, m5*(sizeof(long)+sizeof(boole)));
+	free(a.acov);
+	free(a.bad);
 	return;
 }
 
-void mgf2rmf(char *gfname, char *rmffile, gf_t *gf, rmf_t *rmf, int m6, int m5) /* match gf to feature bed file */
+void mgf2bed(char *gfname, char *ffile, char **fx, int nfx, gf_t *gf, bgr_t2 *bed2, size_t m2, size_t m5, cd_t *cd, ar_t *ar, int nt) /* match gf to feature bed file, and the nfx in fx as well */
 {
-	setlocale(LC_NUMERIC, "");
-	int i, j;
-	int reghits; /* hits for region: number of lines in bed1 which coincide with a region in rmf */
-	int *acov=calloc(m5, sizeof(int)); /* coverage of this chromosome in the bed file */
-	int rangecov=0;
-	int istarthere=0, catchingi=0;
-	int strmatch;
-	boole caught;
+	/* the ones in fx are only read in now, coverage is all they're for. Their strings go in ar */
+	int f, n;
+	cf_t *cf=calloc(nfx+1, sizeof(cf_t));
+	printf("Coverage of \"%s\" (genome size file) by \"%s\"", gfname, ffile); 
+	for(f=0;f<=nfx;++f) {
+		if(f) {
+			printf(", \"%s\"", fx[f-1]); 
+			bed2=processinpf2(fx[f-1], &m2, &n, cd, ar, nt);
+		}
+		cf[f].ft=(char*)bed2;
+		cf[f].sz=sizeof(bgr_t2);
+		cf[f].co=offsetof(bgr_t2, c);
+		cf[f].m=m2;
+	}
+	printf(" (feature bed file%s):\n", (nfx)? "s" : ""); 
+	mgfcov(gf, m5, cf, nfx+1, cd, nt);
+	for(f=1;f<=nfx;++f) {
+		mafree(MA_ROWS, (cf[f].m+1)*sizeof(bgr_t2));
+		free(cf[f].ft);
+	}
+	free(cf);
+	return;
+}
+
+void mgf2rmf(char *gfname, char *rmffile, gf_t *gf, rmf_t *rmf, size_t m6, size_t m5, cd_t *cd, int nt) /* match gf to feature bed file */
+{
+	cf_t cf={(char*)rmf, sizeof(rmf_t), offsetof(rmf_t, c), m6, NULL, NULL};
 	printf("Coverage of \"%s\" (genome size file) by \"%s\" (feature bed file):\n", gfname, rmffile); 
-	for(j=0;j<m5;++j) {
-		caught=0;
-		reghits=0;
-		for(i=istarthere;i<m6;++i) {
-			strmatch=strcmp(gf[j].n, rmf[i].n);
-			if( (!strmatch) & (gf[j].z > rmf[i].c[0]) & (gf[j].z >= rmf[i].c[1]) ) {
-				reghits++;
-				rangecov=rmf[i].c[1] - rmf[i].c[0]; // range covered by this hit
-				acov[j] +=rangecov;
-				catchingi=i;
-				caught=1;
-			} else if (caught) { // will catch first untruth after a series of truths.
-				caught=2;
-				break; // ordered so we can forget about trying to match anymore.
-			} else if( (!strmatch) & (gf[j].z <= rmf[i].c[0]) & (gf[j].z < rmf[i].c[1]) ) {
-				printf("There's a problem with the genome size file ... are you sure it's the right one? Bailing out.\n"); 
+	mgfcov(gf, m5, &cf, 1, cd, nt);
+	return;
+}
+
+typedef struct /* dj_t: what the chromosomes of md2bedp() need */
+{
+	dpf_t *dpf;
+	bgr_t2 *bed2;
+	fs_t *fs;
+	size_t *ri, *rs; /* the depth file's rows grouped by chromosome, and where each chromosome's begin */
+	int *min, *max;
+	long *cloci; /* number of loci */
+	long *assoctval;
+} dj_t;
+
+void md2bedpg(void *v, int g) /* chromosome g of md2bedp() */
+{
+	/* a run of positions [p,p+n) hits the features [s,e) with s<=p+n-1 and e>=p+1, which is the lookup of [p+n-1,p+1),
+	 * and counts for the positions of it inside each, as they would have one by one */
+	dj_t *a=v;
+	size_t i, j, k, z;
+	long l;
+	dpf_t *dp;
+	bgr_t2 *f;
+	if( (a->rs[g]==a->rs[g+1]) || (a->fs->lv[g]<0) )
+		return;
+	size_t *b=malloc((a->fs->gs[g+1]-a->fs->gs[g])*sizeof(size_t)); /* features found for a run */
+	for(i=a->rs[g];i<a->rs[g+1];++i) {
+		dp=a->dpf+a->ri[i];
+		z=fswthn(a->fs, g, dp->p+dp->n-1, dp->p+1, b);
+		for(k=0;k<z;++k) {
+			j=b[k];
+			f=a->bed2+j;
+			l=((f->c[1] < dp->p+dp->n)? f->c[1] : dp->p+dp->n) - ((f->c[0] > dp->p)? f->c[0] : dp->p); /* positions of the run in the feature */
+			if(l<=0) /* ends before it starts */
+				continue;
+			a->cloci[j]+=l;
+			a->assoctval[j]+=l*dp->d;
+			if(dp->d<a->min[j])
+				a->min[j]=dp->d;
+			if(dp->d>a->max[j])
+				a->max[j]=dp->d;
+		}
+	}
+	free(b);
+	return;
+}
+
+void obdp(ob_t *ob, bgr_t2 *b, int mn, int mx, long at, long cl, cd_t *cd) /* a feature's line of the depth match-up */
+{
+	stats.hits += cl;
+	obstr(ob, cd->n[b->ci]);
+	obc(ob, '\t');
+	obl(ob, b->c[0]);
+	obc(ob, '\t');
+	obl(ob, b->c[1]);
+	obc(ob, '\t');
+	obstr(ob, b->f);
+	obc(ob, '\t');
+	obl(ob, mn);
+	obc(ob, '\t');
+	obl(ob, mx);
+	obc(ob, '\t');
+	obl(ob, at);
+	obc(ob, '\t');
+	obf(ob, (float)at/cl, 4);
+	obc(ob, '\n');
+}
+
+void md2bedp(dpf_t *dpf, bgr_t2 *bed2, size_t m2, size_t m, cd_t *cd, int nt) /* match up a samtools depth file (-d option) and a feature bed file (-f option) and print */
+{
+	/* each position looks up the features it's in, with an interval tree for each chromosome, as m2beds() does. So features can
+	 * overlap, and the chromosomes are shared out among nt threads */
+	size_t j;
+	dj_t a;
+	a.dpf=dpf;
+	a.bed2=bed2;
+	a.fs=create_fs(bed2, m2, cd);
+	fsidx(a.fs);
+	a.min=malloc((m2+1)*sizeof(int));
+	a.max=calloc(m2+1, sizeof(int));
+	a.cloci=calloc(m2+1, sizeof(long));
+	a.assoctval=calloc(m2+1, sizeof(long));
+	macnt(MA_JOIN, (m2+1)*(2*sizeof(int)+2*sizeof(long)));
+	for(j=0;j<m2;++j)
+		a.min[j]=9999999;
+	a.ri=gpart(dpf, sizeof(dpf_t), m, a.fs->ng, &a.rs);
+	pjrun(md2bedpg, &a, a.fs->ng, nt);
+	int k=stbeg("output");
+	ob_t *ob=create_ob(STDOUT_FILENO);
+	for(j=0;j<m2;++j)
+		obdp(ob, bed2+j, a.min[j], a.max[j], a.assoctval[j], a.cloci[j], cd);
+	free_ob(ob);
+	stend(k);
+
+	mafree(MA_JOIN, (m2+1)*(2*sizeof(int)+2*sizeof(long)));
+	free(a.min);
+	free(a.max);
+	free(a.cloci);
+	free(a.assoctval);
+	free_gpart(a.ri, a.rs, m, a.fs->ng);
+	free_fs(a.fs);
+	return;
+}
+
+void smd2bedp(char *fname, bgr_t2 *bed2, size_t m2, cd_t *cd) /* md2bedp() streaming the depth file rather than loading it */
+{
+	/* A depth file has a line for every base, so it is read one line at a time and each position is added to the open features
+	 * of its chromosome. A feature is printed once the depth file has gone past its end (or left its chromosome) and all the features
+	 * before it have been printed, so output is in feature file order. Memory goes with the number of features. */
+	size_t i, j, k, nem=0 /* next feature to print */;
+	int nw, d;
+	fs_t *fs=create_fs(bed2, m2, cd);
+	int *min=malloc(m2*sizeof(int)), *max=calloc(m2, sizeof(int));
+	long *cloci=calloc(m2, sizeof(long)); /* number of loci */
+	long *assoctval=calloc(m2, sizeof(long));
+	boole *done=calloc(m2, sizeof(boole)); /* the depth file is past this feature */
+	long p, pp=0;
+	int g=-1, cg=-1, sb=0;
+	boole *sn=calloc(1, sizeof(boole)); /* chromosomes which have been and gone */
+	sl_t w[MXWPL];
+	for(j=0;j<m2;++j)
+		min[j]=9999999;
+	mf_t *mf=mfopen(fname);
+	ob_t *ob=create_ob(STDOUT_FILENO);
+	for(;;) {
+		nw=mfnxtl(mf, w, MXWPL);
+		if(nw!=-1)
+			g=cdid(cd, w[0].s, w[0].l);
+		if( (nw==-1) || (g != cg) ) { /* chromosome is over, as are all its features */
+			for(i=0;i<fs->na;++i)
+				done[fs->act[i]]=1;
+			for(i=fs->nxt;i<fs->lst;++i)
+				done[fs->fk[i].i]=1;
+			if(nw==-1)
+				break;
+			if(g>=sb) {
+				sn=realloc(sn, (g+1)*sizeof(boole));
+				memset(sn+sb, 0, (g+1-sb)*sizeof(boole));
+				sb=g+1;
+			}
+			if(sn[g]) { /* its features have been printed already */
+				obflush(ob);
+				printf("Error: the lines of chromosome %s are not all together in depth file \"%s\", which streaming requires: sort it with -k. Bailing out.\n", cd->n[g], fname); 
 				exit(EXIT_FAILURE);
 			}
+			sn[g]=1;
+			cg=g;
+			fschrom(fs, cg);
+			pp=0;
+		}
+		p=(nw>1)? sl2l(w+1) : 0;
+		d=(nw>2)? (int)sl2l(w+2) : 0;
+		if(p < pp) {
+			obflush(ob);
+			printf("Error: depth file \"%s\" is not in position order within chromosome %s, which streaming requires. Bailing out.\n", fname, cd->n[cg]); 
+			exit(EXIT_FAILURE);
+		}
+		pp=p;
+		fsopen(fs, p);
+		fs->nc[fs->ng] += fs->na;
+		for(i=0,k=0;i<fs->na;++i) {
+			j=fs->act[i];
+			if(bed2[j].c[1] <= p) { // this position and all later ones are beyond this feature.
+				done[j]=1;
+				continue;
+			}
+			fs->act[k++]=j;
+			cloci[j]++;
+			assoctval[j]+=d;
+			if(d<min[j])
+				min[j]=d;
+			if(d>max[j])
+				max[j]=d;
 		}
-		if(caught==2)
-			istarthere=catchingi+1;
-		// printf("%s / cov %2.4f got %i hits from rmf\n", gf[j].n, (float)acov[j]/gf[j].z, reghits);
-		printf("%s\t%4.2f%%\tof %'li bp\n", gf[j].n, 100.*(float)acov[j]/gf[j].z, gf[j].z);
-		if(istarthere >= m6)
+		fs->na=k;
+		while( (nem<m2) && (done[nem]) ) {
+			obdp(ob, bed2+nem, min[nem], max[nem], assoctval[nem], cloci[nem], cd);
+			nem++;
+		}
+	}
+	mfclose(mf);
+	for(;nem<m2;++nem) /* the ones left are on chromosomes the depth file doesn't have */
+		obdp(ob, bed2+nem, min[nem], max[nem], assoctval[nem], cloci[nem], cd);
+	free_ob(ob);
+
+	free(sn);
+	free(min);
+	free(max);
+	free(cloci);
+	free(assoctval);
+	free(done);
+	free_fs(fs);
+	return;
+}
+
+int cmpcn(const void *a, const void *b) /* genome file order first, then the rest in lexicographic order */
+{
+	const cn_t *x=a, *y=b;
+	if(x->gi != y->gi)
+		return (x->gi > y->gi) - (x->gi < y->gi);
+	return strcmp(x->n, y->n);
+}
+
+int *cdrank(cd_t *cd, int ngf) /* the rank of each chromosome id: the first ngf ids come from the genome file, in its order */
+{
+	int g, *r=malloc((cd->z+1)*sizeof(int));
+	cn_t *c=malloc((cd->z+1)*sizeof(cn_t));
+	for(g=0;g<cd->z;++g) {
+		c[g].gi=(g<ngf)? g : INT_MAX;
+		c[g].n=cd->n[g];
+		c[g].id=g;
+	}
+	qsort(c, cd->z, sizeof(cn_t), cmpcn);
+	for(g=0;g<cd->z;++g)
+		r[c[g].id]=g;
+	free(c);
+	return r;
+}
+
+int cmpsk(const void *a, const void *b) /* qsort comparison for sort keys */
+{
+	const sk_t *x=a, *y=b;
+	if(x->r != y->r)
+		return (x->r > y->r) - (x->r < y->r);
+	if(x->s != y->s)
+		return (x->s > y->s) - (x->s < y->s);
+	if(x->e != y->e)
+		return (x->e > y->e) - (x->e < y->e);
+	return (x->q > y->q) - (x->q < y->q);
+}
+
+void srtrun(sk_t *k, size_t nk, char *t, cd_t *cd, int ngf, FILE *fp) /* sort a run and write its lines to fp */
+{
+	/* the keys carry chromosome ids until now, since new names keep turning up and would change the ranks */
+	size_t i;
+	int *rk=cdrank(cd, ngf);
+	for(i=0;i<nk;++i)
+		k[i].r=rk[k[i].r];
+	qsort(k, nk, sizeof(sk_t), cmpsk);
+	for(i=0;i<nk;++i) {
+		fwrite(t+k[i].o, 1, k[i].l, fp);
+		fputc('\n', fp);
+	}
+	free(rk);
+	return;
+}
+
+boole srnxt(sr_t *sr, cd_t *cd, int *rk) /* move a run on to its next line, 0 if it has none */
+{
+	sl_t w[MXWPL];
+	int nw=mfnxtl(sr->mf, w, MXWPL);
+	if(nw==-1)
+		return !(sr->eof=1);
+	sr->k.r=rk[cdid(cd, w[0].s, w[0].l)];
+	sr->k.s=(nw>1)? sl2l(w+1) : 0;
+	sr->k.e=(nw>2)? sl2l(w+2) : 0;
+	sr->t=w[0].s;
+	sr->k.l=sr->mf->p-1 - w[0].s; /* the runs were written by srtrun(), so every line ends in a newline */
+	return 1;
+}
+
+void srheap(sr_t **h, int n, int i) /* sift h[i] down the heap of the n runs' heads */
+{
+	int c;
+	sr_t *x;
+	for(;(c=2*i+1)<n;i=c) {
+		if( (c+1<n) && (cmpsk(&h[c+1]->k, &h[c]->k) < 0) )
+			c++;
+		if(cmpsk(&h[c]->k, &h[i]->k) >= 0)
 			break;
+		x=h[c];
+		h[c]=h[i];
+		h[i]=x;
 	}
-	free(acov);
 	return;
 }
 
-void md2bedp(dpf_t *dpf, bgr_t2 *bed2, int m2, int m) /* match up a samtools depth file (-d option) and a feature bed file (-f option) and print */
+void srtf(char *fname, cd_t *cd, int ngf, size_t bud) /* print fname's lines sorted by chromosome, start and end */
 {
-	int i, j, min, max;
-	int reghits; /* hits for region: number of lines in bed1 which coincide with a region in bed2 */
-	int cloci; /* as opposed to hit, catch the number of loci */
-	long assoctval=0;
-	int istarthere=0, catchingi=0;
-	boole caught;
-	for(j=0;j<m2;++j) {
-		caught=0;
-		reghits=0;
-		cloci=0;
-		assoctval=0;
-		min=9999999;
-		max=0;
-		for(i=istarthere;i<m;++i) {
-			if( !(strcmp(dpf[i].n, bed2[j].n)) & (dpf[i].p >= bed2[j].c[0]) & (dpf[i].p < bed2[j].c[1]) ) {
-				reghits++;
-				cloci++;
-				assoctval+= dpf[i].d;
-				catchingi=i;
-				if(dpf[i].d<min)
-					min=dpf[i].d;
-				if(dpf[i].d>max)
-					max=dpf[i].d;
-				caught=1;
-			} else if (caught) { // will catch first untruth after a series of truths.
-				caught=2;
-				break; // bed1 is ordered so we can forget about trying to match anymore.
+	/* Chromosomes go in the order of the genome file, if there is one (its ids are the first ngf), and any others in
+	 * lexicographic order after it. Lines are taken in until bud bytes of text and keys are used, sorted, and spilled
+	 * to a temporary file as a run. If it all fits there's only the one run and it's printed straight out. Otherwise the runs
+	 * are merged, a heap of their head lines picking the next one. Lines that compare equal keep their file order: within
+	 * a run by q, across them by which run came first. Comment and blank lines are left out */
+	size_t tz=0, tb=1<<16, nk=0, kb=GBUF*GBUF;
+	int i, nw, nr=0, rb=GBUF;
+	char *t=malloc(tb), *tmpd=getenv("TMPDIR");
+	char **rn=malloc(rb*sizeof(char*)); /* the runs' file names */
+	sk_t *k=malloc(kb*sizeof(sk_t));
+	sl_t w[MXWPL];
+	mf_t *mf=mfopen(fname);
+	FILE *fp;
+	for(;;) {
+		nw=mfnxtl(mf, w, MXWPL);
+		if( (nw==-1) || (tz + nk*sizeof(sk_t) > bud) ) { /* run is done */
+			if( (nw==-1) && (!nr) ) { /* it all fitted */
+				srtrun(k, nk, t, cd, ngf, stdout);
+				break;
+			}
+			CONDREALLOC(nr, rb, GBUF, rn, char*);
+			rn[nr]=malloc(strlen((tmpd)? tmpd : "/tmp")+20);
+			sprintf(rn[nr], "%s/bedtack.XXXXXX", (tmpd)? tmpd : "/tmp");
+			int fd=mkstemp(rn[nr]);
+			if( (fd==-1) || !(fp=fdopen(fd, "w")) ) {
+				fprintf(stderr, "Error: cannot make a temporary file for the sort in %s (TMPDIR sets where).\n", (tmpd)? tmpd : "/tmp");
+				exit(EXIT_FAILURE);
+			}
+			srtrun(k, nk, t, cd, ngf, fp);
+			if( (ferror(fp)) | (fclose(fp)) ) {
+				fprintf(stderr, "Error: cannot write the sort's temporary file %s.\n", rn[nr]);
+				unlink(rn[nr]);
+				exit(EXIT_FAILURE);
 			}
+			nr++;
+			tz=nk=0;
+			if(nw==-1)
+				break;
+		}
+		size_t l=(mf->p > mf->e)? (size_t)(mf->e - w[0].s) : (size_t)(mf->p-1 - w[0].s); /* the line, from its first word to its newline */
+		while(tz+l > tb) {
+			tb *= 2;
+			t=realloc(t, tb);
+		}
+		memcpy(t+tz, w[0].s, l);
+		if(nk == kb) {
+			kb *= 2;
+			k=realloc(k, kb*sizeof(sk_t));
+		}
+		k[nk].r=cdid(cd, w[0].s, w[0].l);
+		k[nk].s=(nw>1)? sl2l(w+1) : 0;
+		k[nk].e=(nw>2)? sl2l(w+2) : 0;
+		k[nk].q=nk;
+		k[nk].o=tz;
+		k[nk++].l=l;
+		tz += l;
+	}
+	macnt(MA_ROWS, tb + kb*sizeof(sk_t)); /* they only grow, so this is their most */
+	mfclose(mf);
+	mafree(MA_ROWS, tb + kb*sizeof(sk_t));
+	free(t);
+	free(k);
+	if(nr) {
+		int n=0, *rk=cdrank(cd, ngf); /* every name is in the dictionary by now, so ranks hold for the whole merge */
+		sr_t *sr=calloc(nr, sizeof(sr_t));
+		sr_t **h=malloc(nr*sizeof(sr_t*));
+		for(i=0;i<nr;++i) {
+			sr[i].mf=mfopen(rn[i]);
+			unlink(rn[i]); /* it's mapped, so it goes once it's closed */
+			sr[i].k.q=i;
+			if(srnxt(sr+i, cd, rk))
+				h[n++]=sr+i;
+		}
+		for(i=n/2-1;i>=0;--i)
+			srheap(h, n, i);
+		while(n) {
+			fwrite(h[0]->t, 1, h[0]->k.l, stdout);
+			fputc('\n', stdout);
+			if(!srnxt(h[0], cd, rk))
+				h[0]=h[--n];
+			srheap(h, n, 0);
+		}
+		for(i=0;i<nr;++i) {
+			mfclose(sr[i].mf);
+			free(rn[i]);
 		}
-		if(caught==2)
-			istarthere=catchingi+1;
-		// printf("Bed2idx %i / name %s / size %li got %i hits from dpf , being %i loci and accumulated depth val of %lu\n", j, bed2[j].f, bed2[j].c[1]-bed2[j].c[0], reghits, cloci, assoctval);
-		printf("%s\t%li\t%li\t%s\t%i\t%i\t%li\t%4.4f\n", bed2[j].n, bed2[j].c[0], bed2[j].c[1], bed2[j].f, min, max, assoctval, (float)assoctval/cloci);
+		free(sr);
+		free(h);
+		free(rk);
+	}
+	free(rn);
+	return;
+}
 
-		if(istarthere >= m)
-			break;
+void powr(po_t *po, char *s, size_t l) /* add l bytes to the end of po's file */
+{
+	/* the file is only open while it's written to, so there can be more outputs than file descriptors */
+	int fd=open(po->fn, O_WRONLY|O_CREAT|((po->wtn)? O_APPEND : O_TRUNC), 0644);
+	ssize_t r=0;
+	if(fd==-1) {
+		fprintf(stderr, "Error: cannot open %s for writing.\n", po->fn);
+		exit(EXIT_FAILURE);
+	}
+	while( (l) && ((r=write(fd, s, l)) > 0) ) {
+		s += r;
+		l -= r;
+	}
+	if( (r==-1) | (close(fd)) ) {
+		fprintf(stderr, "Error: cannot write %s.\n", po->fn);
+		exit(EXIT_FAILURE);
 	}
+	po->wtn=1;
 	return;
 }
 
-i4_t *difca(bgr_t *bgrow, int m, int *dcasz, float minsig) /* An temmpt to merge bgraph quickly, no hope */
+void poadd(po_t *po, char *s, size_t l) /* a line for po, l without its newline */
 {
-	int i, goodi=0 /* the last i at which minsig was satisfied */;
-	boole seenminsig=0;
-	/* how many different chromosomes are there? the dc (different chromsosome array */
-	int dcbf=GBUF, dci=0;
-	i4_t *dca=calloc(dcbf, sizeof(i4_t));
-	char *tstr=NULL;
-	/* find first bgrow element which is over the minimum coverage */
-	for(i=0;i<m;++i)
-		if(bgrow[i].co >= minsig) {
-			tstr=malloc(bgrow[i].nsz*sizeof(char)); /* tmp string */
-			strcpy(tstr, bgrow[i].n);
-			dca[dci].sc++;
-			dca[dci].mc=bgrow[i].co;
-			dca[dci].b1i=i;
-			dca[dci].lgbi=i;
-			seenminsig=1;
-			goodi=i;
+	if(po->z + l+1 > POBUF) {
+		powr(po, po->b, po->z);
+		po->z=0;
+	}
+	if(l+1 > POBUF) { /* too long to buffer */
+		powr(po, s, l);
+		powr(po, "\n", 1);
+	} else {
+		memcpy(po->b + po->z, s, l);
+		po->b[po->z + l]='\n';
+		po->z += l+1;
+	}
+	po->nl++;
+	return;
+}
+
+void ptnf(char *fname, char *by) /* partition fname's lines into a file for each feature name, chromosome or value of a column */
+{
+	/* One pass: each line's key (4th column for name, 1st for chrom, otherwise column number by) picks its output,
+	 * which is named after fname with the key put in before the extension. Keys go through a dictionary to their
+	 * output, and the outputs are kept in another, by file name, since keys that only differ in characters that
+	 * can't be in a file name share one. Lines are copied as they are, minus comments, and keep their order */
+	int kc=(!strcmp(by, "name"))? 4 : (!strcmp(by, "chrom"))? 1 : atoi(by);
+	if( (kc < 1) | (kc > MXWPL) ) {
+		fprintf(stderr, "Error: -P needs name, chrom or a column number from 1 to %i.\n", MXWPL);
+		exit(EXIT_FAILURE);
+	}
+	cd_t *kd=create_cd(), *od=create_cd(); /* keys, and the outputs' file names */
+	int nw, i, g, z, kb=GBUF, ob=GBUF;
+	int *ko=malloc(kb*sizeof(int)); /* each key's output */
+	po_t *po=calloc(ob, sizeof(po_t));
+	char *ext=NULL, *sl=strrchr(fname, '/'), *fn, *k;
+	size_t l, kl, rl, el=0, fl=strlen(fname);
+	if( (fl>3) && (!strcmp(fname+fl-3, ".gz")) ) /* outputs aren't gzipped, so that goes */
+		fl -= 3;
+	for(rl=fl;rl>0;--rl) /* the extension, if there is one */
+		if( (fname[rl-1]=='.') | (fname[rl-1]=='/') )
 			break;
+	if( (rl) && (fname[rl-1]=='.') && (fname+rl-1 != ((sl)? sl+1 : fname)) ) {
+		ext=fname+rl-1;
+		el=fl-rl+1;
+		rl--;
+	} else
+		rl=fl;
+	sl_t w[MXWPL];
+	mf_t *mf=mfopen(fname);
+	while( (nw=mfnxtl(mf, w, MXWPL)) != -1) {
+		l=(mf->p > mf->e)? (size_t)(mf->e - w[0].s) : (size_t)(mf->p-1 - w[0].s);
+		while( (l) && (w[0].s[l-1]=='\r') )
+			l--;
+		k=(nw>=kc)? w[kc-1].s : ""; /* lines without the column go together, under a key no word can be */
+		kl=(nw>=kc)? w[kc-1].l : 0;
+		z=kd->z;
+		g=cdid(kd, k, kl);
+		if(kd->z > z) { /* a new key */
+			if(g == kb) {
+				kb *= 2;
+				ko=realloc(ko, kb*sizeof(int));
+			}
+			fn=malloc(rl+kl+el+10);
+			if(kl)
+				sprintf(fn, "%.*s_%.*s%.*s", (int)rl, fname, (int)kl, k, (int)el, (ext)? ext : "");
+			else /* a "." rather than "_" before it, so no key's file can have its name */
+				sprintf(fn, "%.*s._missing%.*s", (int)rl, fname, (int)el, (ext)? ext : "");
+			for(i=rl+1;i<(int)(rl+1+kl);++i)
+				if(fn[i]=='/')
+					fn[i]='_';
+			z=od->z;
+			ko[g]=cdid(od, fn, strlen(fn));
+			if(od->z > z) {
+				CONDREALLOC(ko[g], ob, GBUF, po, po_t);
+				po[ko[g]].fn=od->n[ko[g]];
+				po[ko[g]].b=malloc(POBUF);
+			}
+			free(fn);
+		}
+		poadd(po+ko[g], w[0].s, l);
+	}
+	mfclose(mf);
+	printf("%s partitioned by %s into %i files:\n", fname, by, od->z); 
+	for(i=0;i<od->z;++i) {
+		if(po[i].z)
+			powr(po+i, po[i].b, po[i].z);
+		printf("%s\t%zu lines\n", po[i].fn, po[i].nl);
+		free(po[i].b);
+	}
+	free(po);
+	free(ko);
+	free_cd(kd);
+	free_cd(od);
+	return;
+}
+
+void mrgbg(char *fname, float minsig, long gap, int agg, cd_t *cd) /* merge the bedgraph's rows at or over minsig which are no more than gap apart */
+{
+	/* One pass over the file, only the current run is held, so memory is constant. Rows below minsig end the run
+	 * as well as ones too far on, so runs only span gaps with no rows in them. Each chromosome's rows need to be
+	 * together and in start order. The mean and sum go by bases, so a row counts for its length */
+	int nw, g, cg=-1;
+	long c[2], pc0=0;
+	float co;
+	size_t nr=0;
+	sl_t w[MXWPL];
+	mr_t r={-1, 0, 0, 0, 0, 0, 0};
+	mf_t *mf=mfopen(fname);
+	ob_t *ob=create_ob(STDOUT_FILENO);
+	while( (nw=mfnxtl(mf, w, MXWPL)) != -1) {
+		if(nw >4) {
+			obflush(ob);
+			printf("Error, each row cannot exceed 4 words: revise your input file\n"); 
+			mfclose(mf);
+			exit(EXIT_FAILURE);
+		}
+		c[0]=(nw>1)? sl2l(w+1) : 0;
+		c[1]=(nw>2)? sl2l(w+2) : 0;
+		co=(nw>3)? sl2f(w+3) : 0;
+		g=cdid(cd, w[0].s, w[0].l);
+		if( (g == cg) && (c[0] < pc0) ) {
+			obflush(ob);
+			printf("Error: bedgraph file \"%s\" is not in start order within chromosome %s, which merging requires. Bailing out.\n", fname, cd->n[cg]); 
+			exit(EXIT_FAILURE);
 		}
-	if(!seenminsig) {
+		cg=g;
+		pc0=c[0];
+		if( (r.g != -1) && ((co < minsig) | (g != r.g) | (c[0] - r.e > gap)) ) { /* the run is over */
+			prtmr(ob, &r, agg, cd);
+			r.g=-1;
+			nr++;
+		}
+		if(co < minsig)
+			continue;
+		if(r.g == -1) {
+			r.g=g;
+			r.s=c[0];
+			r.e=c[1];
+			r.mn=r.mx=co;
+			r.sm=0.;
+			r.nb=0;
+		}
+		if(c[1] > r.e)
+			r.e=c[1];
+		if(co < r.mn)
+			r.mn=co;
+		if(co > r.mx)
+			r.mx=co;
+		r.sm += (double)co*(c[1]-c[0]);
+		r.nb += c[1]-c[0];
+	}
+	mfclose(mf);
+	if(r.g != -1) {
+		prtmr(ob, &r, agg, cd);
+		nr++;
+	}
+	free_ob(ob);
+	if(!nr) {
 		printf("Error. No bedgraph element was able to satisfy the minimum signal value that was specified: abandoning ship.\n");
 		exit(EXIT_FAILURE);
 	}
+	return;
+}
 
-	for(i=goodi+1;i<m;++i) {
-		/* the same now means same name and contiguous */
-		if( (!strcmp(tstr, bgrow[i].n)) & (bgrow[i].c[0] == bgrow[dca[dci].lgbi].c[1]) & (bgrow[i].co >= minsig) ) {
-			dca[dci].sc++;
-			dca[dci].lgbi=i;
-			if(bgrow[i].co<dca[dci].mc)
-				dca[dci].mc=bgrow[i].co;
-		} else if (bgrow[i].co >= minsig) {
-			CONDREALLOC(dci, dcbf, GBUF, dca, i4_t);
-			dci++;
-			dca[dci].sc++;
-			dca[dci].mc=bgrow[i].co;
-			dca[dci].b1i=i;
-			dca[dci].lgbi=i;
-			/* new string could be differnt length*/
-			tstr=realloc(tstr, bgrow[i].nsz*sizeof(char)); /* tmp string */
-			strcpy(tstr, bgrow[i].n);
-		}
-	}
-	dca=realloc(dca, (dci+1)*sizeof(i4_t));
-#ifdef DBG
-	printf("Num of different chromcontigs=%i. How many of each? Let's see:\n", dci+1); 
-	printf("dcbf=%i. 4-tupe is sc/mc/b1i/lgbi\n", dcbf); 
-	for(i=0;i<=dci;++i) 
-		printf("%i/%4.2f/%i/%i ",dca[i].sc, dca[i].mc, dca[i].b1i, dca[i].lgbi); 
-	printf("\n"); 
-#endif
-	*dcasz=dci+1;
-	free(tstr);
-	return dca;
+size_t mest(char *fname, size_t rb, boole sf) /* rough bytes loading fname would take: rb a line, and its own length too if sf */
+{
+	/* From the first MLSMP bytes (inflated, if it's gzipped) comes how long a line is and how much the file inflates by,
+	 * and from those and its size on disk, how many lines it has */
+	struct stat sb;
+	gzFile z;
+	char *b;
+	int r, i;
+	size_t nl=0, off;
+	if( (stat(fname, &sb)) || (!S_ISREG(sb.st_mode)) || !(z=gzopen(fname, "rb")) )
+		return 0; /* pipes and the like can't be sized up */
+	b=malloc(MLSMP);
+	gzbuffer(z, 1<<16);
+	r=gzread(z, b, MLSMP);
+	off=gzoffset(z);
+	gzclose(z);
+	for(i=0;i<r;++i)
+		nl += (b[i]=='\n');
+	free(b);
+	if( (r<=0) || (!off) )
+		return 0;
+	if(!nl)
+		nl=1;
+	return (size_t)((double)sb.st_size*nl/off * (rb + ((sf)? (double)r/nl : 0)));
+}
+
+char *mfmt(size_t z, char *b) /* z bytes in b as bytes, KB or MB, whichever keeps it readable. b takes 32 chars */
+{
+	if(z < (1<<10))
+		sprintf(b, "%zu bytes", z);
+	else if(z < (1<<20))
+		sprintf(b, "%.1f KB", (double)z/(1<<10));
+	else
+		sprintf(b, "%.1f MB", (double)z/(1<<20));
+	return b;
+}
+
+double mrun(char *fname) /* what share of a depth file's lines start a run, as pldpf() folds them, from its first MLSMP bytes */
+{
+	/* Lines with the previous line's chromosome and depth, one base on, continue its run. A file that can't be sampled counts every line */
+	gzFile z;
+	char *b, *l, *e, *t, *pc=NULL;
+	int r, pcl=0, cl, pd=0, d;
+	long pp=0, p;
+	size_t nl=0, nr=0;
+	if( !(z=gzopen(fname, "rb")) )
+		return 1.;
+	b=malloc(MLSMP+1);
+	gzbuffer(z, 1<<16);
+	r=gzread(z, b, MLSMP);
+	gzclose(z);
+	if(r<=0) {
+		free(b);
+		return 1.;
+	}
+	b[r]='\0';
+	for(l=b;(e=strchr(l, '\n'));l=e+1) { /* the last, likely cut short, line is left out */
+		for(t=l;(t<e) && (*t!='\t') && (*t!=' ');++t) ;
+		cl=(int)(t-l);
+		p=strtol(t, &t, 10);
+		d=(int)strtol(t, NULL, 10);
+		if( (!nl) || (cl!=pcl) || (memcmp(l, pc, cl)) || (d!=pd) || (p!=pp+1) )
+			nr++;
+		nl++;
+		pc=l;
+		pcl=cl;
+		pd=d;
+		pp=p;
+	}
+	free(b);
+	return (nl)? (double)nr/nl : 1.;
+}
+
+void mlplan(opt_t *opts) /* work out whether what's to be loaded fits in --mem-limit, stream what can be streamed if not, and give up early if that's not enough */
+{
+	/* What a line takes: the row, twice over while the arrays grow or chunks come together, and the indexes the joins put on them.
+	 * -i and -p can be streamed when they're only going to a join with -f (or -i to the details), as with -S. The sort is held to half the limit */
+	size_t ei=0, ef=0, ep=0, er=0;
+	int i;
+	char b[6][32];
+	boole ci=(opts->fstr) || (opts->dflg), cp=(opts->fstr) != NULL; /* -i and -p can be streamed */
+	if( (opts->kstr) && (opts->srtz > opts->mlim/2) )
+		opts->srtz=opts->mlim/2; /* a run always takes one line, however small this is */
+	if( (opts->qstr) || (opts->kstr) || ((opts->mflg) && (opts->istr)) || ((opts->Pstr) && (opts->fstr)) )
+		return; /* these stream anyway */
+	if( (opts->istr) && (!((opts->Sflg) && (ci))) )
+		ei=mest(opts->istr, 2*sizeof(bgl_t)+sizeof(size_t), 0);
+	if(opts->fstr) {
+		ef=mest(opts->fstr, 2*sizeof(bgr_t2)+sizeof(fk_t)+2*sizeof(size_t), 1);
+		for(i=0;i<opts->nfx;++i)
+			ef += mest(opts->fx[i], 2*sizeof(bgr_t2)+sizeof(size_t), 1);
+	}
+	if( (opts->pstr) && (!((opts->Sflg) && (cp))) )
+		ep=(size_t)(mest(opts->pstr, 2*sizeof(dpf_t)+sizeof(size_t), 0)*mrun(opts->pstr)); /* a row a run, not a line */
+	if(opts->rstr)
+		er=mest(opts->rstr, 2*sizeof(rmf_t)+sizeof(size_t), 1);
+	if(ei+ef+ep+er <= opts->mlim)
+		return;
+	if( (ci) && (ei) ) {
+		opts->smi=1;
+		fprintf(stderr, "Note: streaming -i \"%s\" (about %s to load) rather than loading it, to stay under --mem-limit. It has to be sorted for that, as with -S.\n", opts->istr, mfmt(ei, b[0]));
+		ei=0;
+	}
+	if( (ei+ef+ep+er > opts->mlim) && (cp) && (ep) ) {
+		opts->smp=1;
+		fprintf(stderr, "Note: streaming -p \"%s\" (about %s to load) rather than loading it, to stay under --mem-limit. It has to be sorted for that, as with -S.\n", opts->pstr, mfmt(ep, b[0]));
+		ep=0;
+	}
+	if(ei+ef+ep+er > opts->mlim) {
+		fprintf(stderr, "Error: loading the input files would take about %s (-i %s, -f %s, -p %s, -r %s), over the --mem-limit of %s, and nothing more can be streamed.\n",
+				mfmt(ei+ef+ep+er, b[0]), mfmt(ei, b[1]), mfmt(ef, b[2]), mfmt(ep, b[3]), mfmt(er, b[4]), mfmt(opts->mlim, b[5]));
+		exit(EXIT_FAILURE);
+	}
+	return;
 }
 
 void prtusage()
@@ -1247,6 +3865,26 @@ void prtusage()
 	printf("and another bedgraph file, specified by -f, and merges the first into lines defined by the second.\n");
 	printf("Before filtering however, please run with the -d (details) option. This will showi a rough spread of the values,\n");
 	printf("so you can run a second time choosing filtering value (-f) more easily.\n");
+	printf("With -S, the -i bedgraph and the -p depth file are streamed through rather than loaded, so memory stays constant however big they are.\n");
+	printf("With -c, the parsed -i and -f files are kept next to them as .btk files, which later runs load instead, until the file changes.\n");
+	printf("With -w, bedgraph lines only partly inside a feature count too, weighted by the bases inside it.\n");
+	printf("-t N runs the joins (-i or -p against -f, and -g against -f or -r) on N threads, a chromosome at a time. The output is the same.\n");
+	printf("Big -i, -f and -p files are parsed on N threads as well, a piece of the file each.\n");
+	printf("-q chr:start-end (or a bed file of regions) prints the lines of the -i (or else -f) file overlapping it, 0-based and half-open as in bed.\n");
+	printf("The file has to be sorted, and is indexed into a .bti file next to it the first time.\n");
+	printf("-g with -f (or -r) prints how much of each chromosome the features cover, counting overlaps once. -f can be given more than once for this.\n");
+	printf("-k file prints the file sorted by chromosome, start and end, in the order of the -g file's chromosomes if there is one, lexicographic otherwise.\n");
+	printf("Files bigger than -M megabytes (512 by default) are sorted a piece at a time into temporary files in TMPDIR, which are then merged.\n");
+	printf("Any of the input files can be gzipped, BGZF ones (from bgzip) are inflated on -t threads, or one a CPU (up to %i) without -t.\n", MXBZT);
+	printf("-m minsig merges the -i bedgraph's runs of rows with signal at or over minsig into one line each, streaming the file.\n");
+	printf("-G gap lets rows up to gap bases apart merge (0 by default), -a min|max|mean|sum says what signal a merged line gets (min by default).\n");
+	printf("-P name|chrom|N splits the -f file into a file for each feature name, chromosome or value of column N, in one pass.\n");
+	printf("Their names are the -f file's with the value put in before the extension, lines without column N go to one with ._missing there.\n");
+	printf("--stats (or --stats=json) prints the wall and cpu time of each stage of the run on stderr, as a tsv table (or json),\n");
+	printf("with the rows and bytes it read, and, for joins, the rows matched to features and the features they were compared with.\n");
+	printf("--mem-limit N (K, M or G on the end for those) sizes up the input files first, and streams -i or -p (as -S does) if loading them would go over N.\n");
+	printf("If that's not enough it stops there and then, saying how much they would need. The -k sort keeps to half of N. --stats shows the most that was allocated at once, of each kind and all told, and the peak RSS.\n");
+	printf("The -d histogram has 20 buckets, -b sets another number, -l makes them log2 (one per power of 2).\n");
 	return;
 }
 
@@ -1257,105 +3895,198 @@ int main(int argc, char *argv[])
 		prtusage();
 		exit(EXIT_FAILURE);
 	}
-	int i, m, n, m2, n2, m3, n3, m4, n4, m5, n5, m6, n6;
+	size_t i, m, m2, m3, m4, m5, m6; /* row counts */
+	int n, n2, n3, n4, n5, n6; /* column counts */
 	opt_t opts={0};
+	opts.nbk=NUMBUCKETS;
+	opts.srtz=(size_t)SRTMB<<20;
 	catchopts(&opts, argc, argv);
+	bznt=opts.nthr; /* 0 if -t wasn't given */
+	if(!opts.nthr)
+		opts.nthr=1;
+	stats.fmt=opts.stfmt;
+	if(opts.mlim)
+		mlplan(&opts);
+	int k0=stbeg("total"), k; /* k: the stage that's on */
 
 	/* Read in files according to what's defined in options */
-	bgr_t *bgrow=NULL; /* usually macs signal */
+	bgc_t *bgrow=NULL; /* usually macs signal */
 	bgr_t2 *bed2=NULL; /* usually bed file from gff */
 	words_t *bedword=NULL; /* usually feature names of interest */
 	dpf_t *dpf=NULL; /* usually feature names of interest */
 	gf_t *gf=NULL; /* usually genome size file */
 	rmf_t *rmf=NULL; /* usually genome size file */
-	if(opts.istr)
-		bgrow=processinpf(opts.istr, &m, &n);
-	if(opts.fstr)
-		bed2=processinpf2(opts.fstr, &m2, &n2);
-	if(opts.ustr)
-		bedword=processwordf(opts.ustr, &m3, &n3);
-	if(opts.pstr)
-		dpf=processdpf(opts.pstr, &m4, &n4);
-	if(opts.gstr)
-		gf=processgf(opts.gstr, &m5, &n5);
-	if(opts.rstr)
-		rmf=processrmf(opts.rstr, &m6, &n6);
+	cd_t *cd=create_cd(); /* chromosome names, shared by all the files */
+	ar_t *arf=create_ar(), *aru=create_ar(), *arr=create_ar(); /* arenas for the strings of the -f, -u and -r files */
+	if(opts.qstr) { /* a region query reads only what the index points it to */
+		if( (!opts.istr) && (!opts.fstr) ) {
+			printf("Error: a region query (-q) needs a file to look in, -i or -f.\n"); 
+			exit(EXIT_FAILURE);
+		}
+		k=stbeg("query -q");
+		rqry((opts.istr)? opts.istr : opts.fstr, opts.qstr, cd);
+		stend(k);
+		goto final;
+	}
+	if(opts.gstr) { /* first, so the genome file gives the chromosome ids their order */
+		k=stbeg("load -g");
+		gf=processgf(opts.gstr, &m5, &n5, cd);
+		stend(k);
+	}
+	if(opts.kstr) { /* sorting is all that's done */
+		k=stbeg("sort -k");
+		srtf(opts.kstr, cd, cd->z, opts.srtz);
+		stend(k);
+		goto final;
+	}
+	if((opts.mflg) && (opts.istr)) { /* so is merging */
+		k=stbeg("merge -m");
+		mrgbg(opts.istr, opts.minsig, opts.gap, opts.agg, cd);
+		stend(k);
+		goto final;
+	}
+	if((opts.Pstr) && (opts.fstr)) { /* and partitioning */
+		k=stbeg("partition -P");
+		ptnf(opts.fstr, opts.Pstr);
+		stend(k);
+		goto final;
+	}
+	boole strmi=((opts.Sflg) || (opts.smi)) && ((opts.fstr) || (opts.dflg)); /* -i only goes to the match-up or the details, so it can be streamed */
+	k=((opts.istr) && (!strmi))? stbeg("load -i") : -1;
+	if( (opts.istr) && (!strmi) && ((!opts.cflg) || !(bgrow=btkbgc(opts.istr, &m, &n, cd))) ) {
+		bgrow=processinpf(opts.istr, &m, &n, cd, opts.nthr);
+		if(opts.cflg)
+			btkwbgc(opts.istr, bgrow, n, cd);
+	}
+	stend(k);
+	k=(opts.fstr)? stbeg("load -f") : -1;
+	if( (opts.fstr) && ((!opts.cflg) || !(bed2=btkbed2(opts.fstr, &m2, &n2, cd, arf))) ) {
+		bed2=processinpf2(opts.fstr, &m2, &n2, cd, arf, opts.nthr);
+		if(opts.cflg)
+			btkwbed2(opts.fstr, bed2, m2, n2, cd);
+	}
+	stend(k);
+	if(opts.ustr) {
+		k=stbeg("load -u");
+		bedword=processwordf(opts.ustr, &m3, &n3, aru);
+		stend(k);
+	}
+	boole strmp=((opts.Sflg) || (opts.smp)) && (opts.fstr); /* same for -p, the depth file */
+	if((opts.pstr) && (!strmp)) {
+		k=stbeg("load -p");
+		dpf=processdpf(opts.pstr, &m4, &n4, cd, opts.nthr);
+		stend(k);
+	}
+	if(opts.rstr) {
+		k=stbeg("load -r");
+		rmf=processrmf(opts.rstr, &m6, &n6, cd, arr);
+		stend(k);
+	}
 
 	/* conditional execution of certain functions depending on the options */
 	if((opts.dflg) && (opts.istr)) {
-		prtdets(bgrow, m, n, "Target bedgraph (1st) file");
+		k=stbeg("details -i");
+		if(strmi)
+			sprtdets(opts.istr, "Target bedgraph (1st) file", opts.nbk, opts.lflg);
+		else
+			prtdets(bgrow, n, "Target bedgraph (1st) file", opts.nbk, opts.lflg);
+		stend(k);
 		goto final;
 	}
 	if((opts.dflg) && (opts.gstr)) {
-		prtdetg(opts.gstr, gf, m5, n5, "Size file");
+		k=stbeg("details -g");
+		prtdetg(opts.gstr, gf, m5, n5, "Size file", cd);
+		stend(k);
 		goto final;
 	}
 	if((opts.nflg) && (opts.fstr)) {
+		k=stbeg("names -n");
 		prtbed2fo(opts.fstr, bed2, m2, n2, "Feature (bed2)");
+		stend(k);
 		goto final;
 	}
 	// prtbed2(bed2, m2, MXCOL2VIEW);
-	if((opts.istr) && (opts.fstr))
-		m2beds(bgrow, bed2, m2, m);
+	if((opts.istr) && (opts.fstr)) {
+		k=stbeg("join -i -f");
+		if(strmi)
+			sm2beds(opts.istr, bed2, m2, cd, opts.wflg);
+		else if(opts.wflg)
+			sw2beds(bgrow, bed2, m2, cd);
+		else
+			m2beds(bgrow, bed2, m2, cd, opts.nthr);
+		stend(k);
+	}
 	if((opts.ustr) && (opts.fstr) && (!opts.sflg)) {
 		printf("bedwords:\n"); 
 		for(i=0;i<m3;++i)
 			printf("%s\n", bedword[i].n);
 	}
-	if((opts.pstr) && (opts.fstr) )
-		md2bedp(dpf, bed2, m2, m4);
+	if((opts.pstr) && (opts.fstr) ) {
+		k=stbeg("join -p -f");
+		if(strmp)
+			smd2bedp(opts.pstr, bed2, m2, cd);
+		else
+			md2bedp(dpf, bed2, m2, m4, cd, opts.nthr);
+		stend(k);
+	}
 
-	if((opts.dflg) && (opts.rstr) )
-		prtrmf(opts.rstr, rmf, m6);
+	if((opts.dflg) && (opts.rstr) ) {
+		k=stbeg("details -r");
+		prtrmf(opts.rstr, rmf, m6, cd);
+		stend(k);
+	}
 
-	if((opts.gstr) && (opts.rstr) )
-		mgf2rmf(opts.gstr, opts.rstr, gf, rmf, m6, m5);
+	if((opts.gstr) && (opts.rstr) ) {
+		k=stbeg("coverage -g -r");
+		mgf2rmf(opts.gstr, opts.rstr, gf, rmf, m6, m5, cd, opts.nthr);
+		stend(k);
+	}
 
-	if((opts.gstr) && (opts.fstr) )
-		mgf2bed(opts.gstr, opts.fstr, gf, bed2, m2, m5);
+	if((opts.gstr) && (opts.fstr) ) {
+		k=stbeg("coverage -g -f");
+		mgf2bed(opts.gstr, opts.fstr, opts.fx, opts.nfx, gf, bed2, m2, m5, cd, arf, opts.nthr);
+		stend(k);
+	}
 	// if((opts.ustr) && (opts.fstr) && opts.sflg)
-	// 	prtbed2s(bed2, m2, MXCOL2VIEW, bedword, m3, n3, "bed2 features that are in interesting-feature-file");
+	// 	prtbed2s(bed2, m2, MXCOL2VIEW, bedword, m3, "bed2 features that are in interesting-feature-file");
 
 	ia_t *ia=NULL;
 	if((opts.ustr) && (opts.fstr) && opts.sflg) {
-		ia=gensplbdx(bed2, m2, n2, bedword, m3, n3);
-		bed2in2(opts.fstr, bed2, m2, n2, ia);
+		k=stbeg("split -u -s");
+		ia=gensplbdx(bed2, m2, bedword, m3);
+		bed2in2(opts.fstr, bed2, m2, n2, ia, cd);
+		free(ia->a);
+		free(ia);
+		stend(k);
 	}
 
 final:
-	if(opts.pstr) {
-		for(i=0;i<m4;++i)
-			free(dpf[i].n);
-		free(dpf);
-	}
-	if(opts.istr) {
-		for(i=0;i<m;++i)
-			free(bgrow[i].n);
-		free(bgrow);
-	}
-	if(opts.fstr) {
-		for(i=0;i<m2;++i) {
-			free(bed2[i].n);
-			free(bed2[i].f);
-		}
-		free(bed2);
-	}
-	if(opts.rstr) {
-		for(i=0;i<m6;++i) {
-			free(rmf[i].n);
-			free(rmf[i].m);
-		}
-		free(rmf);
-	}
-	if(opts.gstr) {
-		for(i=0;i<m5;++i)
-			free(gf[i].n);
-		free(gf);
-	}
-	if(opts.ustr) {
-		for(i=0;i<m3;++i)
-			free(bedword[i].n);
-		free(bedword);
+	if(dpf)
+		mafree(MA_ROWS, (m4+1)*sizeof(dpf_t));
+	if(bed2)
+		mafree(MA_ROWS, (m2+1)*sizeof(bgr_t2));
+	if(rmf)
+		mafree(MA_ROWS, m6*sizeof(rmf_t));
+	if(gf)
+		mafree(MA_ROWS, m5*sizeof(gf_t));
+	if(bedword)
+		mafree(MA_ROWS, m3*sizeof(words_t));
+	free(dpf);
+	if(bgrow)
+		free_bgc(bgrow);
+	free(bed2);
+	free(rmf);
+	free(gf);
+	free(bedword);
+	free(opts.fx);
+	free_ar(arf);
+	free_ar(aru);
+	free_ar(arr);
+	free_cd(cd);
+	if(stats.fmt) {
+		fflush(stdout);
+		stend(k0);
+		prtst();
 	}
 
 	return 0;
@@ -0,0 +1,145 @@
+/* bedgen.c: makes up bedtack input files of any size, for benchmarking.
+   Copyright (C) 2014  Ramon Fallon
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License
+   as published by the Free Software Foundation; either version 2
+   of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include<unistd.h> // required for optopt, opterr and optarg.
+
+typedef struct /* opt_t, a struct for the options */
+{
+	char *kind; /* bg, bed, dp, gff or sz */
+	long n; /* rows, shared out evenly among the chromosomes */
+	int c; /* number of chromosomes */
+	long z; /* bases in each chromosome */
+	float d; /* bed and gff: how many features cover a base, on average */
+	long r; /* dp: how many bases share a depth, on average */
+	unsigned long long sd; /* random seed, so the same options give the same file */
+} opt_t;
+
+unsigned long long rnd(unsigned long long *s) /* xorshift64 */
+{
+	*s ^= *s<<13;
+	*s ^= *s>>7;
+	*s ^= *s<<17;
+	return *s;
+}
+
+long rlen(unsigned long long *s, long mn) /* a length averaging mn, from mn/2 to 3mn/2, at least 1 */
+{
+	long l=mn/2 + (long)(rnd(s)%(unsigned long long)(mn+1));
+	return (l<1)? 1 : l;
+}
+
+int cmpl(const void *a, const void *b)
+{
+	long x=*(const long*)a, y=*(const long*)b;
+	return (x > y) - (x < y);
+}
+
+void prtusage()
+{
+	printf("bedgen: makes up a bedtack input file on stdout, for benchmarking. Each kind covers all the chromosomes, chr1 to chrN, evenly.\n");
+	printf("-k bg|bed|dp|gff|sz: bedgraph (-i), feature bed (-f), samtools depth file (-p), repeatmasker gff2 (-r) or size file (-g)\n");
+	printf("-n rows (1000000 by default), -c chromosomes (16), -z bases in each chromosome (1000000),\n");
+	printf("-d how many features overlap a base on average, for bed and gff (1.0), -s random seed (1),\n");
+	printf("-r how many bases in a row share a depth on average, for dp (1, a new depth every base).\n");
+	printf("Bedgraph rows tile the chromosomes, depth file rows are one a base from its start, their runs of equal depth of geometric length.\n");
+	return;
+}
+
+int main(int argc, char *argv[])
+{
+	opt_t opts={NULL, 1000000, 16, 1000000, 1.0, 1, 1};
+	int o, g, dp;
+	long i, k, np, l, p, *st;
+	if(argc == 1) {
+		prtusage();
+		exit(EXIT_FAILURE);
+	}
+	while ((o = getopt (argc, argv, "k:n:c:z:d:r:s:")) != -1)
+		switch (o) {
+			case 'k':
+				opts.kind = optarg;
+				break;
+			case 'n':
+				opts.n = atol(optarg);
+				break;
+			case 'c':
+				opts.c = atoi(optarg);
+				break;
+			case 'z':
+				opts.z = atol(optarg);
+				break;
+			case 'd':
+				opts.d = atof(optarg);
+				break;
+			case 'r':
+				opts.r = atol(optarg);
+				break;
+			case 's':
+				opts.sd = strtoull(optarg, NULL, 10);
+				break;
+			default:
+				fprintf (stderr, "Wrong arguments. Please launch without arguments to see help file.\n");
+				exit(EXIT_FAILURE);
+		}
+	if( (!opts.kind) || (opts.n < 1) || (opts.c < 1) || (opts.z < 1) || (opts.d <= 0) || (opts.r < 1) ) {
+		fprintf (stderr, "Error: -k is needed, and -n, -c, -z, -d and -r have to be over 0.\n");
+		exit(EXIT_FAILURE);
+	}
+	unsigned long long s=opts.sd*2654435761ULL+1;
+	np=(opts.n + opts.c-1)/opts.c; /* rows for each chromosome */
+	st=malloc(np*sizeof(long));
+	for(g=1;g<=opts.c;++g) {
+		if(!strcmp(opts.kind, "sz"))
+			printf("chr%i\t%li\n", g, opts.z);
+		else if(!strcmp(opts.kind, "bg")) { /* tiles of random length, the last one stops at the chromosome's end */
+			for(i=0,p=0;(i<np) && (p<opts.z);++i,p+=l) {
+				l=(i==np-1)? opts.z-p : rlen(&s, opts.z/np);
+				if(p+l > opts.z)
+					l=opts.z-p;
+				printf("chr%i\t%li\t%li\t%.2f\n", g, p, p+l, (float)(rnd(&s)%10000)/100.);
+			}
+		} else if(!strcmp(opts.kind, "dp")) { /* a new depth with chance 1/r at each base, so runs average r bases */
+			for(i=0,dp=0;i<np;++i) {
+				if( (i==0) || (rnd(&s)%(unsigned long long)opts.r == 0) )
+					dp=(int)(rnd(&s)%200);
+				printf("chr%i\t%li\t%i\n", g, i+1, dp);
+			}
+		} else if( (!strcmp(opts.kind, "bed")) | (!strcmp(opts.kind, "gff")) ) { /* random starts, in order, lengths so the overlap is about d */
+			l=(long)(opts.d*opts.z/np);
+			for(i=0;i<np;++i)
+				st[i]=rnd(&s)%(unsigned long long)opts.z;
+			qsort(st, np, sizeof(long), cmpl);
+			for(i=0;i<np;++i) {
+				k=st[i]+rlen(&s, l);
+				if(k > opts.z)
+					k=opts.z;
+				if(opts.kind[0]=='b')
+					printf("chr%i\t%li\t%li\tf%i_%li\n", g, st[i], k, g, i);
+				else
+					printf("chr%i\tRepeatMasker\tsimilarity\t%li\t%li\t%4.1f\t%c\t.\tTarget \"Motif:(CA)n\" 1 %li\n", g, st[i]+1, k, (float)(rnd(&s)%300)/10., (rnd(&s)&1)? '+' : '-', k-st[i]);
+			}
+		} else {
+			fprintf (stderr, "Error: -k has to be bg, bed, dp, gff or sz.\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	free(st);
+	return 0;
+}
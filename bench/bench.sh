@@ -0,0 +1,50 @@
+#!/bin/bash
+# bench.sh: times bedtack's readers and joins on made-up data, see "make bench".
+# usage: bench.sh BEDTACK BEDGEN DIR ROWS CHROMS DENSITY THREADS REPEATS RUNLEN
+# Each reader is timed by loading its file and doing nothing else, each join with all its inputs,
+# so a join's own time is roughly its total less its readers'. Rows/s and MB/s are of all the inputs.
+# Each is run REPEATS times and the fastest is the one reported. Depth file bases share a depth RUNLEN at a time, on average.
+B=$1; G=$2; D=$3; N=${4:-2000000}; C=${5:-16}; O=${6:-1}; T=${7:-1}; R=${8:-3}; L=${9:-1}
+Z=$(( N / C * 50 )) # bedgraph rows average 50 bases
+mkdir -p $D || exit 1
+
+gen() { # kind rows file
+	[ -s $3 ] && [ $3 -nt $G ] && [ "$(cat $3.opts 2>/dev/null)" == "$N $C $O $L" ] && return
+	$G -k $1 -n $2 -c $C -z $Z -d $O -r $L > $3 || exit 1
+	echo "$N $C $O $L" > $3.opts
+}
+gen bg $N $D/b.bg
+gen bed $(( N / 10 )) $D/f.bed
+gen dp $N $D/d.txt
+gen gff $(( N / 10 )) $D/r.gff
+gen sz $C $D/g.sizes
+
+now() { date +%s%N; }
+rows() { local r=0; for f in "$@"; do r=$(( r + $(wc -l < $f) )); done; echo $r; }
+bytes() { local z=0; for f in "$@"; do z=$(( z + $(stat -c %s $f) )); done; echo $z; }
+
+run() { # name, then the files it reads, then -- and bedtack's arguments
+	local nm=$1 fs=() t0 t i b=0; shift
+	while [ "$1" != "--" ]; do fs+=($1); shift; done; shift
+	for(( i=0; i<R; ++i )); do
+		t0=$(now)
+		$B -t $T "$@" > /dev/null || { echo "$nm: bedtack failed" >&2; exit 1; }
+		t=$(( $(now) - t0 ))
+		(( b==0 || t<b )) && b=$t
+	done
+	awk -v nm="$nm" -v r=$(rows ${fs[@]}) -v z=$(bytes ${fs[@]}) -v ns=$b 'BEGIN {
+		s=ns/1e9; if(s<=0) s=1e-9;
+		printf("%-24s %12d %10.1f %9.3f %14.0f %10.1f\n", nm, r, z/1048576, s, r/s, z/1048576/s) }'
+}
+
+echo "bedtack benchmark: $N rows over $C chromosomes of $Z bases, feature overlap $O, depth runs of $L, $T threads, best of $R, data in $D"
+printf "%-24s %12s %10s %9s %14s %10s\n" "stage" "rows" "MB" "seconds" "rows/s" "MB/s"
+run "read bedgraph (-i)" $D/b.bg -- -i $D/b.bg
+run "read features (-f)" $D/f.bed -- -f $D/f.bed
+run "read depth (-p)" $D/d.txt -- -p $D/d.txt
+run "read gff2 (-r)" $D/r.gff -- -r $D/r.gff
+run "read sizes (-g)" $D/g.sizes -- -g $D/g.sizes
+run "join m2beds (-i -f)" $D/b.bg $D/f.bed -- -i $D/b.bg -f $D/f.bed
+run "join md2bedp (-p -f)" $D/d.txt $D/f.bed -- -p $D/d.txt -f $D/f.bed
+run "join mgf2bed (-g -f)" $D/g.sizes $D/f.bed -- -g $D/g.sizes -f $D/f.bed
+run "join mgf2rmf (-g -r)" $D/g.sizes $D/r.gff -- -g $D/g.sizes -r $D/r.gff